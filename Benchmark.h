@@ -0,0 +1,145 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// options for the headless benchmark mode (--bench)
+struct BenchOptions {
+    bool enabled = false;
+    bool geometryOnly = false; // --bench-geometry: time the mesh generators, no GL context
+    int frames = 600;       // measured frames
+    int warmupFrames = 30;  // frames rendered before measuring starts
+    int width = 1280;
+    int height = 720;
+    std::string outputPath; // empty = write JSON to stdout
+    int schoolSize = 400;   // AI fish in the school, split between the two species (also without --bench)
+    int threads = -1;       // simulation worker threads: -1 = one per core besides the render thread, 0 = serial
+};
+
+// parses --bench, --bench-geometry, --frames N, --warmup N, --size WxH, --bench-out PATH, --school N and --threads N
+BenchOptions parseBenchOptions(int argc, char** argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--bench")
+            options.enabled = true;
+        else if (arg == "--bench-geometry")
+            options.geometryOnly = true;
+        else if (arg == "--frames" && hasValue)
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && hasValue)
+            options.warmupFrames = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--size" && hasValue)
+        {
+            std::string size = argv[++i];
+            size_t x = size.find('x');
+            if (x != std::string::npos)
+            {
+                options.width = std::max(1, std::atoi(size.substr(0, x).c_str()));
+                options.height = std::max(1, std::atoi(size.substr(x + 1).c_str()));
+            }
+        }
+        else if (arg == "--bench-out" && hasValue)
+            options.outputPath = argv[++i];
+        else if (arg == "--school" && hasValue)
+            options.schoolSize = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--threads" && hasValue)
+            options.threads = std::max(-1, std::atoi(argv[++i]));
+    }
+    return options;
+}
+
+// collects frame times of a benchmark run and reports them as JSON
+class FrameStats
+{
+public:
+    void reserve(size_t frames)
+    {
+        frameTimes.reserve(frames);
+    }
+
+    void addFrame(double seconds)
+    {
+        frameTimes.push_back(seconds);
+        totalTime += seconds;
+    }
+
+    // extra numbers (draw calls, culled objects, ...) reported under "counters"
+    void setCounter(const std::string& name, double value)
+    {
+        for (auto& counter : counters)
+        {
+            if (counter.first == name)
+            {
+                counter.second = value;
+                return;
+            }
+        }
+        counters.push_back(std::make_pair(name, value));
+    }
+
+    size_t frameCount() const
+    {
+        return frameTimes.size();
+    }
+
+    // nearest-rank percentile of the recorded frame times, p in [0, 100]
+    double percentile(double p) const
+    {
+        if (frameTimes.empty())
+            return 0.0;
+
+        std::vector<double> sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+
+        size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+        rank = std::min(std::max(rank, (size_t)1), sorted.size());
+        return sorted[rank - 1];
+    }
+
+    void writeJson(std::ostream& out) const
+    {
+        double frames = (double)frameTimes.size();
+        double mean = frames > 0 ? totalTime / frames : 0.0;
+        double minTime = frameTimes.empty() ? 0.0 : *std::min_element(frameTimes.begin(), frameTimes.end());
+        double maxTime = frameTimes.empty() ? 0.0 : *std::max_element(frameTimes.begin(), frameTimes.end());
+
+        out << std::fixed << std::setprecision(4);
+        out << "{\n";
+        out << "  \"frames\": " << frameTimes.size() << ",\n";
+        out << "  \"total_seconds\": " << totalTime << ",\n";
+        out << "  \"fps\": " << (totalTime > 0.0 ? frames / totalTime : 0.0) << ",\n";
+        out << "  \"frame_ms\": {\n";
+        out << "    \"mean\": " << mean * 1000.0 << ",\n";
+        out << "    \"min\": " << minTime * 1000.0 << ",\n";
+        out << "    \"p50\": " << percentile(50.0) * 1000.0 << ",\n";
+        out << "    \"p95\": " << percentile(95.0) * 1000.0 << ",\n";
+        out << "    \"p99\": " << percentile(99.0) * 1000.0 << ",\n";
+        out << "    \"max\": " << maxTime * 1000.0 << "\n";
+        out << "  },\n";
+        out << "  \"counters\": {";
+        for (size_t i = 0; i < counters.size(); i++)
+        {
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    \"" << counters[i].first << "\": " << counters[i].second;
+        }
+        out << (counters.empty() ? "}\n" : "\n  }\n");
+        out << "}" << std::endl;
+    }
+
+private:
+    std::vector<double> frameTimes;
+    std::vector<std::pair<std::string, double>> counters;
+    double totalTime = 0.0;
+};
+#endif
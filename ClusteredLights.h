@@ -0,0 +1,317 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "FrameUniforms.h"
+#include "Frustum.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <future>
+#include <thread>
+#include <vector>
+
+// texture units of the light buffers; the lower units are left to material textures
+const unsigned int LIGHT_DATA_UNIT = 2;
+const unsigned int LIGHT_CLUSTERS_UNIT = 3;
+const unsigned int LIGHT_INDICES_UNIT = 4;
+
+// point light with a finite range, its contribution is faded out to zero at radius
+struct PointLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    float intensity;
+};
+
+// distance at which intensity / d^2 falls below cutoff, a good radius for a light of that intensity
+float pointLightRadius(float intensity, float cutoff = 1.0f / 256.0f)
+{
+    return std::sqrt(intensity / cutoff);
+}
+
+// clustered light culling. The view frustum is divided into CLUSTERS_X * CLUSTERS_Y screen tiles and
+// CLUSTERS_Z exponential depth slices. Every frame each light is assigned on the CPU to the clusters its
+// sphere touches, and three buffer textures are uploaded:
+//   lights   (RGBA32F): 2 texels per light, (position, radius) and (color * intensity, 0)
+//   clusters (RG32UI):  per cluster (first index, light count)
+//   indices  (R32UI):   light indices of all clusters, one run per cluster
+// A fragment finds its cluster from gl_FragCoord and its view depth (lighting.glsl) and only loops over
+// the lights of that cluster, so its cost depends on the lights nearby instead of all lights in the scene.
+class ClusteredLights
+{
+public:
+    static const int CLUSTERS_X = 16;
+    static const int CLUSTERS_Y = 9;
+    static const int CLUSTERS_Z = 24;
+    static const int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+    // depth range that is sliced; fragments outside of it use the first or last slice
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    // threads used for the assignment (1 = only the calling thread). Small light counts are always
+    // assigned on the calling thread, starting threads would cost more than the work itself.
+    size_t workerCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+
+    // statistics of the last update
+    size_t visibleLights = 0;
+    size_t assignedIndices = 0;
+
+    void create()
+    {
+        lightData = createBufferTexture(GL_RGBA32F, lightBuffer);
+        clusterData = createBufferTexture(GL_RG32UI, clusterBuffer);
+        indexData = createBufferTexture(GL_R32UI, indexBuffer);
+    }
+
+    ~ClusteredLights()
+    {
+        GLState& state = GLState::instance();
+        unsigned int textures[3] = { lightData, clusterData, indexData };
+        unsigned int buffers[3] = { lightBuffer, clusterBuffer, indexBuffer };
+        for (unsigned int texture : textures)
+            state.forgetTexture(texture);
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    size_t lightCount() const
+    {
+        return lightCount_;
+    }
+
+    // assigns the lights to clusters, uploads the buffers and fills the cluster parameters of the frame block
+    void update(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+        int viewportWidth, int viewportHeight, FrameData& frame)
+    {
+        lightCount_ = lights.size();
+        lightBounds.clear();
+        for (const PointLight& light : lights)
+            lightBounds.push_back({ light.position, light.radius });
+        sliceScale = CLUSTERS_Z / std::log(farPlane / nearPlane);
+        sliceBias = -CLUSTERS_Z * std::log(nearPlane) / std::log(farPlane / nearPlane);
+
+        ranges.clear();
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            ClusterRange range;
+            if (clusterRange(lights[i], view, projection, range))
+            {
+                range.light = (GLuint)i;
+                ranges.push_back(range);
+            }
+        }
+        visibleLights = ranges.size();
+
+        assign();
+        upload(lights);
+
+        frame.clusterScale = glm::vec4((float)CLUSTERS_X / viewportWidth, (float)CLUSTERS_Y / viewportHeight, sliceScale, sliceBias);
+        frame.clusterCount = glm::ivec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, (int)lights.size());
+    }
+
+    // true when the world space sphere is in range of at least one light of the last update, so the
+    // caller can pick a program without point lights for everything else
+    bool touches(const BoundingSphere& bounds) const
+    {
+        for (const BoundingSphere& light : lightBounds)
+        {
+            float reach = light.radius + bounds.radius;
+            glm::vec3 offset = light.center - bounds.center;
+            if (glm::dot(offset, offset) <= reach * reach)
+                return true;
+        }
+        return false;
+    }
+
+    // binds the buffer textures to their units, the samplers of the programs point at them
+    void bind() const
+    {
+        GLState& state = GLState::instance();
+        state.bindTextureBuffer(LIGHT_DATA_UNIT, lightData);
+        state.bindTextureBuffer(LIGHT_CLUSTERS_UNIT, clusterData);
+        state.bindTextureBuffer(LIGHT_INDICES_UNIT, indexData);
+    }
+
+private:
+    // clusters touched by one light, inclusive
+    struct ClusterRange {
+        GLuint light;
+        int minX, maxX, minY, maxY, minZ, maxZ;
+    };
+
+    // below this many light/cluster tests the assignment stays on one thread
+    static const size_t PARALLEL_THRESHOLD = 32 * CLUSTER_COUNT;
+
+    unsigned int lightBuffer = 0, clusterBuffer = 0, indexBuffer = 0;
+    unsigned int lightData = 0, clusterData = 0, indexData = 0;
+
+    size_t lightCount_ = 0;
+    float sliceScale = 1.0f, sliceBias = 0.0f;
+
+    std::vector<BoundingSphere> lightBounds; // world space spheres of the lights, for touches()
+    std::vector<ClusterRange> ranges;
+    std::vector<GLuint> clusters;                  // (first, count) per cluster
+    std::vector<std::vector<GLuint>> chunkIndices; // light indices of each group of slices
+    std::vector<GLuint> indices;
+    std::vector<glm::vec4> lightTexels;
+
+    unsigned int createBufferTexture(GLenum format, unsigned int& buffer)
+    {
+        glGenBuffers(1, &buffer);
+        GLState::instance().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        GLState::instance().bindTextureBuffer(LIGHT_DATA_UNIT, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        return texture;
+    }
+
+    int slice(float depth) const
+    {
+        int z = (int)std::floor(std::log(depth) * sliceScale + sliceBias);
+        return std::min(std::max(z, 0), CLUSTERS_Z - 1);
+    }
+
+    // cluster range of the light's sphere; false when it is behind the camera or off screen
+    bool clusterRange(const PointLight& light, const glm::mat4& view, const glm::mat4& projection, ClusterRange& range) const
+    {
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        float nearest = -center.z - light.radius;
+        float farthest = -center.z + light.radius;
+        if (farthest <= nearPlane || nearest >= farPlane)
+            return false;
+
+        range.minZ = slice(std::max(nearest, nearPlane));
+        range.maxZ = slice(std::min(farthest, farPlane));
+
+        if (nearest <= nearPlane)
+        {
+            // the sphere reaches the camera, it can cover any part of the screen
+            range.minX = 0; range.maxX = CLUSTERS_X - 1;
+            range.minY = 0; range.maxY = CLUSTERS_Y - 1;
+            return true;
+        }
+
+        // screen rectangle of the view space box around the sphere; all its corners are in front of the camera
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 offset((corner & 1) ? light.radius : -light.radius,
+                (corner & 2) ? light.radius : -light.radius,
+                (corner & 4) ? light.radius : -light.radius);
+            glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+            float x = clip.x / clip.w, y = clip.y / clip.w;
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+        }
+        if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+            return false;
+
+        range.minX = tile(minX, CLUSTERS_X); range.maxX = tile(maxX, CLUSTERS_X);
+        range.minY = tile(minY, CLUSTERS_Y); range.maxY = tile(maxY, CLUSTERS_Y);
+        return true;
+    }
+
+    static int tile(float ndc, int tiles)
+    {
+        int t = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+        return std::min(std::max(t, 0), tiles - 1);
+    }
+
+    // fills the clusters of slices [firstSlice, lastSlice), offsets are relative to the chunk's own index list
+    void assignSlices(int firstSlice, int lastSlice, std::vector<GLuint>& out)
+    {
+        out.clear();
+        std::vector<const ClusterRange*> sliceLights;
+        for (int z = firstSlice; z < lastSlice; z++)
+        {
+            sliceLights.clear();
+            for (const ClusterRange& range : ranges)
+                if (z >= range.minZ && z <= range.maxZ)
+                    sliceLights.push_back(&range);
+
+            for (int y = 0; y < CLUSTERS_Y; y++)
+            {
+                for (int x = 0; x < CLUSTERS_X; x++)
+                {
+                    size_t cluster = ((size_t)z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+                    GLuint first = (GLuint)out.size();
+                    for (const ClusterRange* range : sliceLights)
+                    {
+                        if (x >= range->minX && x <= range->maxX && y >= range->minY && y <= range->maxY)
+                            out.push_back(range->light);
+                    }
+                    clusters[cluster * 2] = first;
+                    clusters[cluster * 2 + 1] = (GLuint)out.size() - first;
+                }
+            }
+        }
+    }
+
+    // every group of slices writes only its own clusters and index list, the lists are joined afterwards
+    void assign()
+    {
+        clusters.assign(CLUSTER_COUNT * 2, 0);
+
+        size_t chunks = ranges.size() * CLUSTER_COUNT < PARALLEL_THRESHOLD ? 1 : std::min(workerCount, (size_t)CLUSTERS_Z);
+        chunkIndices.resize(std::max(chunks, chunkIndices.size()));
+
+        auto firstSlice = [chunks](size_t chunk) { return (int)(chunk * CLUSTERS_Z / chunks); };
+
+        std::vector<std::future<void>> workers;
+        for (size_t chunk = 1; chunk < chunks; chunk++)
+        {
+            workers.push_back(std::async(std::launch::async, [this, chunk, &firstSlice]() {
+                assignSlices(firstSlice(chunk), firstSlice(chunk + 1), chunkIndices[chunk]);
+            }));
+        }
+        assignSlices(firstSlice(0), firstSlice(1), chunkIndices[0]);
+        for (std::future<void>& worker : workers)
+            worker.get();
+
+        indices.clear();
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            GLuint base = (GLuint)indices.size();
+            size_t first = (size_t)firstSlice(chunk) * CLUSTERS_X * CLUSTERS_Y;
+            size_t last = (size_t)firstSlice(chunk + 1) * CLUSTERS_X * CLUSTERS_Y;
+            for (size_t cluster = first; cluster < last; cluster++)
+                clusters[cluster * 2] += base;
+            indices.insert(indices.end(), chunkIndices[chunk].begin(), chunkIndices[chunk].end());
+        }
+        assignedIndices = indices.size();
+    }
+
+    void upload(const std::vector<PointLight>& lights)
+    {
+        lightTexels.clear();
+        for (const PointLight& light : lights)
+        {
+            lightTexels.push_back(glm::vec4(light.position, light.radius));
+            lightTexels.push_back(glm::vec4(light.color * light.intensity, 0.0f));
+        }
+
+        uploadBuffer(lightBuffer, lightTexels.data(), lightTexels.size() * sizeof(glm::vec4));
+        uploadBuffer(clusterBuffer, clusters.data(), clusters.size() * sizeof(GLuint));
+        uploadBuffer(indexBuffer, indices.data(), indices.size() * sizeof(GLuint));
+    }
+
+    // respecifies the whole store every frame (orphaning), so the driver never waits for the previous frame
+    static void uploadBuffer(unsigned int buffer, const void* data, size_t bytes)
+    {
+        GLState::instance().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if (bytes == 0)
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        else
+            glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STREAM_DRAW);
+    }
+};
+#endif
@@ -0,0 +1,79 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+// fixed step simulation clock ("Fix Your Timestep!", Glenn Fiedler). Frame time is accumulated and consumed
+// in steps of exactly `step` seconds, so the simulation does the same work and gives the same results at any
+// frame rate. What is left in the accumulator (less than one step) is the fraction by which rendering
+// interpolates between the previous and the current simulation state.
+class FixedTimestep
+{
+public:
+    double step;
+    int maxSteps; // catch-up limit per frame; time beyond it is dropped instead of simulated
+
+    // statistics, reported by the benchmark
+    size_t steps = 0;        // steps simulated
+    size_t droppedSteps = 0; // steps skipped because a frame took too long
+
+    explicit FixedTimestep(double step = 1.0 / 120.0, int maxSteps = 8)
+        : step(step), maxSteps(maxSteps)
+    {
+    }
+
+    // adds the frame time and returns how many steps to simulate this frame
+    int advance(double frameTime)
+    {
+        accumulator += frameTime;
+
+        int count = 0;
+        while (accumulator >= step && count < maxSteps)
+        {
+            accumulator -= step;
+            count++;
+        }
+
+        // after a stall (window dragged, breakpoint) catching up would only make the next frame slower too
+        if (accumulator >= step)
+        {
+            double dropped = std::floor(accumulator / step);
+            droppedSteps += (size_t)dropped;
+            accumulator -= dropped * step;
+        }
+
+        steps += count;
+        simulatedTime += count * step;
+        return count;
+    }
+
+    // how far rendering is between the previous (0) and the current (1) simulation state
+    float alpha() const
+    {
+        return (float)(accumulator / step);
+    }
+
+    // time of the rendered (interpolated) state
+    double time() const
+    {
+        return simulatedTime + accumulator;
+    }
+
+private:
+    double accumulator = 0.0;
+    double simulatedTime = 0.0;
+};
+
+// interpolates angles in radians along the shorter way around the circle
+float mixAngle(float from, float to, float alpha)
+{
+    float difference = std::fmod(to - from, glm::two_pi<float>());
+    if (difference > glm::pi<float>()) difference -= glm::two_pi<float>();
+    else if (difference < -glm::pi<float>()) difference += glm::two_pi<float>();
+    return from + difference * alpha;
+}
+#endif
@@ -0,0 +1,48 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// binding point of the "FrameData" uniform block, shared by every program that declares it
+const GLuint FRAME_DATA_BINDING = 0;
+
+// CPU mirror of the std140 "FrameData" block declared in frame_data.glsl (included by every scene shader).
+// std140 aligns a vec3 to 16 bytes, so each one is followed by a float (padding or a packed scalar).
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;        float pad0;
+    glm::vec3 lightPos;       float pad1;
+    glm::vec3 lightColor;     float pad2;
+
+    // clustered point lights (ClusteredLights.h): x, y = clusters per pixel, z, w = depth slice scale and bias
+    glm::vec4 clusterScale;
+    glm::ivec4 clusterCount;  // clusters along x, y, z and the number of lights
+};
+static_assert(sizeof(FrameData) == 208, "FrameData must match the std140 layout of the GLSL block");
+
+// uniform buffer holding the per-frame camera and lighting data. It is uploaded once per frame and
+// read by all programs through FRAME_DATA_BINDING, so adding programs costs nothing per frame.
+class FrameUniformBuffer
+{
+public:
+    unsigned int UBO = 0;
+
+    void create()
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void update(const FrameData& data)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+#endif
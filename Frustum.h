@@ -0,0 +1,93 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+// world space bounding sphere
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// bounding sphere of a local space AABB after transform. The radius is scaled by the largest axis scale
+// of the transform, so it stays conservative for rotated and non-uniformly scaled objects.
+BoundingSphere transformBounds(const glm::vec3& minBounds, const glm::vec3& maxBounds, const glm::mat4& transform)
+{
+    glm::vec3 localCenter = (minBounds + maxBounds) * 0.5f;
+    float localRadius = glm::length(maxBounds - minBounds) * 0.5f;
+
+    float scale = std::max(glm::length(glm::vec3(transform[0])),
+        std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+    BoundingSphere sphere;
+    sphere.center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+    sphere.radius = localRadius * scale;
+    return sphere;
+}
+
+// the six planes of a view frustum, extracted from projection * view (Gribb/Hartmann).
+// Planes point inwards, a point p is inside a plane when dot(normal, p) + d >= 0.
+class Frustum
+{
+public:
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        extract(viewProjection);
+    }
+
+    void extract(const glm::mat4& m)
+    {
+        // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+
+        for (glm::vec4& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    bool intersectsSphere(const BoundingSphere& sphere) const
+    {
+        return intersectsSphere(sphere.center, sphere.radius);
+    }
+
+    // world space AABB test: only the corner furthest along each plane normal has to be checked
+    bool intersectsAABB(const glm::vec3& minBounds, const glm::vec3& maxBounds) const
+    {
+        for (const glm::vec4& plane : planes)
+        {
+            glm::vec3 positive(
+                plane.x >= 0.0f ? maxBounds.x : minBounds.x,
+                plane.y >= 0.0f ? maxBounds.y : minBounds.y,
+                plane.z >= 0.0f ? maxBounds.z : minBounds.z);
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,228 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstddef>
+
+// shadow copy of the GL state the renderer touches. Every call goes through here, is compared with the
+// value already set and only reaches the driver when it changes something. Code that changes this state
+// with raw gl* calls has to call invalidate() afterwards, objects deleted with glDelete* have to be forgotten.
+class GLState
+{
+public:
+    // statistics, reported by the benchmark
+    size_t issued = 0;   // calls forwarded to GL
+    size_t skipped = 0;  // redundant calls that were dropped
+
+    static const int MAX_TEXTURE_UNITS = 16;
+
+    static GLState& instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (!changes(currentProgram, program)) return;
+        glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vao)
+    {
+        if (!changes(currentVertexArray, vao)) return;
+        glBindVertexArray(vao);
+    }
+
+    // only GL_ARRAY_BUFFER is tracked; the element buffer binding belongs to the VAO
+    void bindBuffer(GLenum target, GLuint buffer)
+    {
+        if (target == GL_ARRAY_BUFFER)
+        {
+            if (!changes(currentArrayBuffer, buffer)) return;
+        }
+        else
+            issued++;
+        glBindBuffer(target, buffer);
+    }
+
+    // unit is the index, not GL_TEXTUREi
+    void activeTexture(unsigned int unit)
+    {
+        if (!changes(currentUnit, unit)) return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds a 2D texture to the active unit
+    void bindTexture(GLuint texture)
+    {
+        if (currentUnit >= MAX_TEXTURE_UNITS)
+        {
+            issued++;
+            glBindTexture(GL_TEXTURE_2D, texture);
+            return;
+        }
+        if (!changes(boundTextures[currentUnit], texture)) return;
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    void bindTexture(unsigned int unit, GLuint texture)
+    {
+        if (unit < MAX_TEXTURE_UNITS && boundTextures[unit] == texture)
+        {
+            skipped++;
+            return;
+        }
+        activeTexture(unit);
+        bindTexture(texture);
+    }
+
+    // buffer textures (GL_TEXTURE_BUFFER) are tracked apart from the 2D bindings of the same unit
+    void bindTextureBuffer(unsigned int unit, GLuint texture)
+    {
+        if (unit < MAX_TEXTURE_UNITS && boundTextureBuffers[unit] == texture)
+        {
+            skipped++;
+            return;
+        }
+        activeTexture(unit);
+        if (unit < MAX_TEXTURE_UNITS)
+            boundTextureBuffers[unit] = texture;
+        issued++;
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        GLuint* current = capabilitySlot(capability);
+        if (current && !changes(*current, enabled ? 1u : 0u)) return;
+        if (!current) issued++;
+
+        if (enabled) glEnable(capability);
+        else glDisable(capability);
+    }
+
+    void depthMask(bool enabled)
+    {
+        if (!changes(currentDepthMask, enabled ? 1u : 0u)) return;
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    }
+
+    void cullFace(GLenum mode)
+    {
+        if (!changes(currentCullFace, mode)) return;
+        glCullFace(mode);
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        blendFuncSeparate(source, destination, source, destination);
+    }
+
+    void blendFuncSeparate(GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha)
+    {
+        GLuint packed[4] = { sourceRGB, destinationRGB, sourceAlpha, destinationAlpha };
+        if (std::equal(packed, packed + 4, currentBlendFunc))
+        {
+            skipped++;
+            return;
+        }
+        std::copy(packed, packed + 4, currentBlendFunc);
+        issued++;
+        glBlendFuncSeparate(sourceRGB, destinationRGB, sourceAlpha, destinationAlpha);
+    }
+
+    // GL_FRAMEBUFFER binding (draw and read together)
+    void bindFramebuffer(GLuint framebuffer)
+    {
+        if (!changes(currentFramebuffer, framebuffer)) return;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+
+    // glDelete* unbinds deleted objects, so the shadow copy has to follow
+    void forgetProgram(GLuint program)
+    {
+        if (currentProgram == program) currentProgram = 0;
+    }
+    void forgetVertexArray(GLuint vao)
+    {
+        if (currentVertexArray == vao) currentVertexArray = 0;
+    }
+    void forgetBuffer(GLuint buffer)
+    {
+        if (currentArrayBuffer == buffer) currentArrayBuffer = 0;
+    }
+    void forgetFramebuffer(GLuint framebuffer)
+    {
+        if (currentFramebuffer == framebuffer) currentFramebuffer = 0;
+    }
+    void forgetTexture(GLuint texture)
+    {
+        for (GLuint& bound : boundTextures)
+            if (bound == texture) bound = 0;
+        for (GLuint& bound : boundTextureBuffers)
+            if (bound == texture) bound = 0;
+    }
+
+    // forgets everything, the next call of each kind always reaches GL
+    void invalidate()
+    {
+        currentProgram = currentVertexArray = currentArrayBuffer = currentUnit = UNKNOWN;
+        for (GLuint& bound : boundTextures)
+            bound = UNKNOWN;
+        for (GLuint& bound : boundTextureBuffers)
+            bound = UNKNOWN;
+        depthTest = cullFaceEnabled = blend = UNKNOWN;
+        currentDepthMask = currentCullFace = currentFramebuffer = UNKNOWN;
+        for (GLuint& factor : currentBlendFunc)
+            factor = UNKNOWN;
+    }
+
+    void resetCounters()
+    {
+        issued = 0;
+        skipped = 0;
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLuint currentProgram, currentVertexArray, currentArrayBuffer, currentUnit;
+    GLuint boundTextures[MAX_TEXTURE_UNITS];
+    GLuint boundTextureBuffers[MAX_TEXTURE_UNITS];
+    GLuint depthTest, cullFaceEnabled, blend;
+    GLuint currentDepthMask, currentCullFace, currentFramebuffer;
+    GLuint currentBlendFunc[4];
+
+    GLState()
+    {
+        invalidate();
+    }
+
+    // stores value and returns true if it differs from the tracked one, counts the call either way
+    bool changes(GLuint& current, GLuint value)
+    {
+        if (current == value)
+        {
+            skipped++;
+            return false;
+        }
+        current = value;
+        issued++;
+        return true;
+    }
+
+    GLuint* capabilitySlot(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_DEPTH_TEST: return &depthTest;
+        case GL_CULL_FACE: return &cullFaceEnabled;
+        case GL_BLEND: return &blend;
+        default: return nullptr;
+        }
+    }
+};
+#endif
@@ -0,0 +1,63 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <GL/glew.h>
+
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// one per-instance vertex attribute (float components, advanced once per instance)
+struct InstanceAttribute {
+    GLuint location;
+    GLint components;
+    size_t offset;
+};
+
+// vertex buffer with per-instance data, drawn together with a Mesh through glDrawElementsInstanced
+class InstanceBuffer
+{
+public:
+    unsigned int VBO = 0;
+    size_t stride = 0;
+    size_t capacity = 0; // in bytes
+    std::vector<InstanceAttribute> attributes;
+
+    void create(size_t instanceStride, const std::vector<InstanceAttribute>& instanceAttributes)
+    {
+        stride = instanceStride;
+        attributes = instanceAttributes;
+        glGenBuffers(1, &VBO);
+    }
+
+    // points the instance attributes of a VAO at this buffer, starting at instance firstInstance
+    void attach(unsigned int VAO, size_t firstInstance = 0) const
+    {
+        GLState::instance().bindVertexArray(VAO);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        for (const InstanceAttribute& attribute : attributes)
+        {
+            glEnableVertexAttribArray(attribute.location);
+            glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE, (GLsizei)stride,
+                (void*)(attribute.offset + firstInstance * stride));
+            glVertexAttribDivisor(attribute.location, 1);
+        }
+    }
+
+    // replaces the buffer contents with count instances. The storage is orphaned every time so the driver
+    // never waits for the previous frame, and grows geometrically when it is too small.
+    void upload(const void* data, size_t count, GLenum usage = GL_STREAM_DRAW)
+    {
+        size_t bytes = count * stride;
+        if (bytes > capacity)
+            capacity = std::max(bytes, capacity * 2);
+
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, capacity, NULL, usage);
+        if (bytes > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+    }
+};
+#endif
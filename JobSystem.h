@@ -0,0 +1,249 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// one unit of work. It is queued once every job it depends on has finished, and when it finishes itself
+// it releases the jobs that were waiting on it.
+struct Job {
+    std::function<void()> work;
+    std::atomic<int> pendingDependencies{ 0 };
+    std::atomic<bool> finished{ false };
+
+    std::mutex mutex;
+    bool done = false;                          // under mutex, decides whether a new dependent has to wait
+    std::vector<std::shared_ptr<Job>> dependents;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// work-stealing thread pool. Every worker has its own queue: it takes the newest job of its own queue
+// (which is likely still in its cache) and, when that is empty, steals the oldest job of another queue.
+// Threads that are not workers (the render thread) push to a shared queue and help with the work while
+// they wait, so with zero workers everything simply runs on the calling thread.
+// Jobs must not touch OpenGL, the context belongs to the render thread.
+class JobSystem
+{
+public:
+    // statistics, reported by the benchmark
+    std::atomic<size_t> jobsRun{ 0 };
+    std::atomic<size_t> steals{ 0 };
+
+    // workerCount < 0 = one worker per core besides the calling thread; 0 = no workers, every job runs on
+    // the thread that waits for it (the serial baseline)
+    explicit JobSystem(int workerCount = -1)
+    {
+        if (workerCount < 0)
+            workerCount = (int)std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+        // queue 0 belongs to the threads that are not workers
+        for (int i = 0; i <= workerCount; i++)
+            queues.emplace_back(new WorkQueue());
+        for (int i = 1; i <= workerCount; i++)
+            workers.emplace_back(&JobSystem::workerLoop, this, (size_t)i);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    size_t workerCount() const
+    {
+        return workers.size();
+    }
+
+    // queues work to run after all of dependencies have finished
+    JobHandle schedule(std::function<void()> work, const std::vector<JobHandle>& dependencies = {})
+    {
+        JobHandle job = std::make_shared<Job>();
+        job->work = std::move(work);
+
+        // the extra count keeps the job from starting while its dependencies are still being registered
+        job->pendingDependencies = 1;
+        for (const JobHandle& dependency : dependencies)
+        {
+            if (!dependency) continue;
+
+            std::lock_guard<std::mutex> lock(dependency->mutex);
+            if (!dependency->done)
+            {
+                job->pendingDependencies++;
+                dependency->dependents.push_back(job);
+            }
+        }
+
+        release(job);
+        return job;
+    }
+
+    // calls body(begin, end) over [0, count) split into batches of at least minBatch items. The returned
+    // job finishes when all batches have, so later stages can depend on the whole loop.
+    JobHandle parallelFor(size_t count, size_t minBatch, std::function<void(size_t, size_t)> body,
+        const std::vector<JobHandle>& dependencies = {})
+    {
+        // a few batches per thread, so a thread that finishes early can steal the rest
+        size_t maxBatches = (workers.size() + 1) * 4;
+        size_t batchSize = std::max(std::max<size_t>(minBatch, 1), (count + maxBatches - 1) / maxBatches);
+
+        std::vector<JobHandle> batches;
+        for (size_t begin = 0; begin < count; begin += batchSize)
+        {
+            size_t end = std::min(count, begin + batchSize);
+            batches.push_back(schedule([body, begin, end]() { body(begin, end); }, dependencies));
+        }
+
+        if (batches.empty())
+            return schedule([]() {}, dependencies);
+        return schedule([]() {}, batches);
+    }
+
+    // runs queued jobs on the calling thread until job has finished
+    void wait(const JobHandle& job)
+    {
+        while (!job->finished.load(std::memory_order_acquire))
+        {
+            if (!runOne(queueIndex()))
+                std::this_thread::yield();
+        }
+    }
+
+    // schedule + wait, for work that the caller needs right away
+    void run(std::function<void()> work, const std::vector<JobHandle>& dependencies = {})
+    {
+        wait(schedule(std::move(work), dependencies));
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    // idle workers sleep here instead of spinning
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<size_t> queuedJobs{ 0 };
+    bool stopping = false;
+
+    // queue of the calling thread: its own for workers, the shared one for everybody else
+    static size_t& threadQueue()
+    {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    size_t queueIndex() const
+    {
+        size_t index = threadQueue();
+        return index < queues.size() ? index : 0;
+    }
+
+    void release(const JobHandle& job)
+    {
+        if (--job->pendingDependencies != 0)
+            return;
+
+        {
+            // counted before it is pushed, so a thread that takes it right away never sees the count below zero;
+            // taking the lock orders the increment with a worker that is about to go to sleep
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queuedJobs++;
+        }
+        WorkQueue& queue = *queues[queueIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(job);
+        }
+        wakeUp.notify_one();
+    }
+
+    JobHandle take(size_t own)
+    {
+        {
+            WorkQueue& queue = *queues[own];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.jobs.empty())
+            {
+                JobHandle job = queue.jobs.back();
+                queue.jobs.pop_back();
+                return job;
+            }
+        }
+
+        for (size_t offset = 1; offset < queues.size(); offset++)
+        {
+            WorkQueue& victim = *queues[(own + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty())
+            {
+                JobHandle job = victim.jobs.front();
+                victim.jobs.pop_front();
+                steals++;
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    bool runOne(size_t own)
+    {
+        JobHandle job = take(own);
+        if (!job)
+            return false;
+        queuedJobs--;
+
+        job->work();
+        job->work = nullptr; // captured state is released as soon as the job is done
+
+        std::vector<JobHandle> dependents;
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->done = true;
+            dependents.swap(job->dependents);
+        }
+        job->finished.store(true, std::memory_order_release);
+        jobsRun++;
+
+        for (const JobHandle& dependent : dependents)
+            release(dependent);
+        return true;
+    }
+
+    void workerLoop(size_t index)
+    {
+        threadQueue() = index;
+        while (true)
+        {
+            if (runOne(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this]() { return stopping || queuedJobs > 0; });
+            if (stopping)
+                return;
+        }
+    }
+};
+#endif
@@ -0,0 +1,79 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// number of levels in every LOD chain, 0 = most detailed
+const int LOD_LEVELS = 4;
+
+// picks a level of detail from the projected screen space radius of a bounding sphere
+class LodSelector
+{
+public:
+    // a level is used while the projected radius (in pixels) is at least its threshold, the last level below that
+    float minPixelRadius[LOD_LEVELS - 1] = { 16.0f, 6.0f, 2.0f };
+
+    LodSelector(const glm::vec3& cameraPos, const glm::mat4& projection, float viewportHeight)
+        : cameraPos(cameraPos)
+    {
+        // projection[1][1] = cot(fovy / 2): a sphere of radius r at distance d covers r / d * that many half-viewports
+        pixelScale = projection[1][1] * viewportHeight * 0.5f;
+    }
+
+    float projectedRadius(const glm::vec3& center, float radius) const
+    {
+        float distance = glm::length(center - cameraPos);
+        if (distance <= radius)
+            return pixelScale; // camera inside the sphere, as detailed as possible
+        return radius * pixelScale / distance;
+    }
+
+    int select(const glm::vec3& center, float radius, int levelCount = LOD_LEVELS) const
+    {
+        float pixels = projectedRadius(center, radius);
+        int level = 0;
+        while (level < levelCount - 1 && level < LOD_LEVELS - 1 && pixels < minPixelRadius[level])
+            level++;
+        return level;
+    }
+
+private:
+    glm::vec3 cameraPos;
+    float pixelScale;
+};
+
+// contiguous run of instances drawn with one LOD level
+struct LodRange {
+    size_t first = 0;
+    size_t count = 0;
+};
+
+// stable counting sort of instances by level: out holds the instances of level 0, then level 1, ...
+// and ranges[level] tells where each level starts, so every level is one instanced draw from the same buffer
+template <typename T>
+void groupByLod(const std::vector<T>& instances, const std::vector<int>& levels, std::vector<T>& out, LodRange (&ranges)[LOD_LEVELS])
+{
+    for (LodRange& range : ranges)
+        range = LodRange();
+    for (int level : levels)
+        ranges[level].count++;
+
+    size_t first = 0;
+    for (LodRange& range : ranges)
+    {
+        range.first = first;
+        first += range.count;
+    }
+
+    size_t next[LOD_LEVELS];
+    for (int level = 0; level < LOD_LEVELS; level++)
+        next[level] = ranges[level].first;
+
+    out.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++)
+        out[next[levels[i]]++] = instances[i];
+}
+#endif
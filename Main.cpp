@@ -1,5 +1,4 @@
-﻿#define STB_IMAGE_IMPLEMENTATION
-#define _USE_MATH_DEFINES
+﻿#define _USE_MATH_DEFINES
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -9,8 +8,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <iostream>
+#include <fstream>
+#include <iomanip>
 #include <chrono>
 #include <thread>
+#include <future>
+#include <functional>
 #include <vector>
 #include <string>
 #include <cmath>
@@ -20,6 +23,20 @@
 #include "Mesh.h"
 #include "Model.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
+#include "SpatialHash.h"
+#include "Benchmark.h"
+#include "ClusteredLights.h"
+#include "FixedTimestep.h"
+#include "FrameUniforms.h"
+#include "Frustum.h"
+#include "GLState.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+#include "Lod.h"
+#include "RenderQueue.h"
+#include "TransparencyPass.h"
+#include "TextureCache.h"
 
 GLFWwindow* window;
 int screenWidth, screenHeight;
@@ -45,6 +62,12 @@ float sandWidth = tankWidth - 2 * wallThickness;
 float sandDepth = tankDepth - 2 * wallThickness;
 float sandHeight = 0.8f;
 
+// Bitovi varijanti basic/texture sejdera (ShaderVariants), redom kao imena define-ova
+const unsigned int POINT_LIGHTS = 1u << 0;
+
+// Bitovi varijanti fish sejdera
+const unsigned int FISH_INSTANCED = 1u << 0;
+
 glm::vec3 goldfishInput(0.0f);
 glm::vec3 clownfishInput(0.0f);
 
@@ -53,32 +76,16 @@ bool isXPressed = false;
 bool isFPressed = false;
 bool isCPressed = false;
 
+// Teksture idu kroz globalni TextureCache: isti fajl (npr. wood.png za svih 6 delova kovcega)
+// se dekodira i salje na GPU samo jednom
 unsigned int loadTexture(const char* path) {
-    unsigned int textureID;
-
-    glGenTextures(1, &textureID);
-
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // or GL_NEAREST
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // or GL_NEAREST
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // or GL_CLAMP_TO_EDGE
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); // or GL_CLAMP_TO_EDGE
-    }
-    else {
-        std::cerr << "Failed to load texture: " << path << std::endl;
-    }
-    stbi_image_free(data);
-    return textureID;
+    TextureOptions options;
+    options.flipVertically = true;
+    options.mipmapFiltering = false;
+    return TextureCache::instance().acquire(path, options);
 }
 
-Mesh createCubeMesh(glm::vec3 size, bool inwardNormals = false, const std::string& texturePath = "")
+MeshData buildCubeMeshData(glm::vec3 size, bool inwardNormals = false)
 {
     float x = size.x / 2, y = size.y / 2, z = size.z / 2;
     float dir = inwardNormals ? -1.0f : 1.0f;
@@ -113,7 +120,12 @@ Mesh createCubeMesh(glm::vec3 size, bool inwardNormals = false, const std::strin
         20,21,22, 22,23,20 // Top
     };
 
-    std::vector<Texture> textures;
+    return MeshData(std::move(vertices), std::move(indices));
+}
+
+Mesh createCubeMesh(glm::vec3 size, bool inwardNormals = false, const std::string& texturePath = "")
+{
+    MeshData data = buildCubeMeshData(size, inwardNormals);
 
     if (!texturePath.empty())
     {
@@ -121,13 +133,13 @@ Mesh createCubeMesh(glm::vec3 size, bool inwardNormals = false, const std::strin
         tex.id = loadTexture(texturePath.c_str());
         tex.type = "texture_diffuse";
         tex.path = texturePath;
-        textures.push_back(tex);
+        data.textures.push_back(tex);
     }
 
-    return Mesh(vertices, indices, textures);
+    return Mesh(std::move(data));
 }
 
-Mesh createSandMeshFilled(int rows, int cols, float width, float depth, float maxHeight)
+MeshData buildSandMeshData(int rows, int cols, float width, float depth, float maxHeight)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
@@ -256,11 +268,16 @@ Mesh createSandMeshFilled(int rows, int cols, float width, float depth, float ma
     for (auto& v : vertices)
         v.Normal = glm::normalize(v.Normal);
 
-    std::vector<Texture> textures;
-    return Mesh(vertices, indices, textures);
+    return MeshData(std::move(vertices), std::move(indices));
 }
 
-Mesh createCylinderMesh(float height, float radius, int segments)
+Mesh createSandMeshFilled(int rows, int cols, float width, float depth, float maxHeight)
+{
+    // visine peska se citaju na CPU (getSandHeightAt), pa ova mreza cuva svoje vertekse
+    return Mesh(buildSandMeshData(rows, cols, width, depth, maxHeight), true);
+}
+
+MeshData buildCylinderMeshData(float height, float radius, int segments)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
@@ -315,14 +332,35 @@ Mesh createCylinderMesh(float height, float radius, int segments)
         indices.push_back(t2);
     }
 
-    return Mesh(vertices, indices, {});
+    return MeshData(std::move(vertices), std::move(indices));
 }
 
-Mesh createSphereMesh(float radius = 1.0f, int sectors = 12, int stacks = 8)
+Mesh createCylinderMesh(float height, float radius, int segments)
+{
+    return Mesh(buildCylinderMeshData(height, radius, segments));
+}
+
+// LOD lanac valjka: svaki sledeci nivo ima oko 2/3 segmenata prethodnog (najmanje 3)
+std::vector<MeshData> buildCylinderLodChainData(float height, float radius, int segments)
+{
+    std::vector<MeshData> levels;
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        levels.push_back(buildCylinderMeshData(height, radius, segments));
+        segments = std::max(3, segments * 2 / 3);
+    }
+    return levels;
+}
+
+std::vector<Mesh> createCylinderLodChain(float height, float radius, int segments)
+{
+    std::vector<MeshData> levels = buildCylinderLodChainData(height, radius, segments);
+    return uploadMeshes(levels);
+}
+
+MeshData buildSphereMeshData(float radius = 1.0f, int sectors = 12, int stacks = 8)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
 
     for (int i = 0; i <= stacks; ++i) {
         float stackAngle = glm::pi<float>() / 2 - i * glm::pi<float>() / stacks;
@@ -360,10 +398,33 @@ Mesh createSphereMesh(float radius = 1.0f, int sectors = 12, int stacks = 8)
         }
     }
 
-    return Mesh(vertices, indices, textures);
+    return MeshData(std::move(vertices), std::move(indices));
 }
 
-Mesh createCoinMesh(float radius, float thickness, int segments)
+Mesh createSphereMesh(float radius = 1.0f, int sectors = 12, int stacks = 8)
+{
+    return Mesh(buildSphereMeshData(radius, sectors, stacks));
+}
+
+// LOD lanac sfere: 12x8 -> 8x5 -> 5x3 -> 3x2, poslednji nivo je svega nekoliko trouglova
+std::vector<MeshData> buildSphereLodChainData(float radius, int sectors, int stacks)
+{
+    std::vector<MeshData> levels;
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        levels.push_back(buildSphereMeshData(radius, sectors, stacks));
+        sectors = std::max(3, sectors * 2 / 3);
+        stacks = std::max(2, stacks * 2 / 3);
+    }
+    return levels;
+}
+
+std::vector<Mesh> createSphereLodChain(float radius, int sectors, int stacks)
+{
+    std::vector<MeshData> levels = buildSphereLodChainData(radius, sectors, stacks);
+    return uploadMeshes(levels);
+}
+
+MeshData buildCoinMeshData(float radius, float thickness, int segments)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
@@ -446,12 +507,15 @@ Mesh createCoinMesh(float radius, float thickness, int segments)
         indices.push_back(b1);
     }
 
-    std::vector<Texture> textures;
+    return MeshData(std::move(vertices), std::move(indices));
+}
 
-    return Mesh(vertices, indices, textures);
+Mesh createCoinMesh(float radius, float thickness, int segments)
+{
+    return Mesh(buildCoinMeshData(radius, thickness, segments));
 }
 
-Mesh createGemMesh(float size)
+MeshData buildGemMeshData(float size)
 {
     std::vector<Vertex> vertices = {
         {{ 0,  size,  0}, { 0, 1, 0}, {0.5f,1.0f}},  // top
@@ -476,9 +540,12 @@ Mesh createGemMesh(float size)
         5,1,4
     };
 
-    std::vector<Texture> textures;
+    return MeshData(std::move(vertices), std::move(indices));
+}
 
-    return Mesh(vertices, indices, textures);
+Mesh createGemMesh(float size)
+{
+    return Mesh(buildGemMeshData(size));
 }
 
 float getSandHeightAt(const Mesh& sand, float x, float z, int rows, int cols, float width, float depth)
@@ -533,9 +600,9 @@ struct Overlay {
         unsigned int EBO;
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::instance().bindVertexArray(VAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
@@ -551,32 +618,24 @@ struct Overlay {
         textureID = loadTexture(texPath.c_str());
     }
 
-    void Draw(Shader& shader, float screenWidth, float screenHeight, float posX = 10.0f, float posY = 10.0f) {
+    void submit(RenderQueue& queue, Shader& shader, float screenWidth, float screenHeight, float posX = 10.0f, float posY = 10.0f) {
+        // Projekcija i sampler su isti za ceo program, pa se postavljaju odmah
         shader.use();
-
-        bool prevCull = cullFaceEnabled;
-        bool prevDepth = depthTestEnabled;
-
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-        glDepthMask(GL_FALSE);
-
         glm::mat4 ortho = glm::ortho(0.0f, screenWidth, 0.0f, screenHeight);
         shader.setMat4("projection", ortho);
         shader.setInt("overlayTex", 0);
 
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(posX, screenHeight - posY - height, 0.0f));
-        shader.setMat4("model", model);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        glDepthMask(GL_TRUE);
-        if (prevCull) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-        if (prevDepth) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
+        DrawItem item;
+        item.pass = PASS_OVERLAY;
+        item.shader = &shader;
+        item.VAO = VAO;
+        item.indexCount = 6;
+        item.texture = textureID;
+        item.model = glm::translate(glm::mat4(1.0f), glm::vec3(posX, screenHeight - posY - height, 0.0f));
+        item.cullFace = false;
+        item.depthTest = false;
+        item.depthWrite = false;
+        queue.submit(item);
     }
 };
 
@@ -586,97 +645,378 @@ struct AquariumBounds {
     float minZ, maxZ;
 };
 
-struct Bubble {
+struct FoodParticle {
     glm::vec3 position;
+    glm::vec3 previousPosition;
     float speed;
     float radius;
-    float driftPhase = 0.0f;
-    float driftAmplitude = 0.1f;
+    float targetY;
+    size_t sequence; // redni broj bacanja, manji = stariji
 };
 
-struct FoodParticle {
+// Podaci jedne instance sfere (mehur, hrana) u instance baferu: location 3 = pozicija + poluprecnik, 4 = alfa
+struct SphereInstance {
     glm::vec3 position;
-    float speed;
     float radius;
-    float targetY;
-    bool alive = true;
+    float alpha;
 };
 
-class AlgaeBush {
+// Skuplja sve sfere jednog tipa tokom frejma i crta ih jednim instanciranim pozivom po LOD nivou
+class InstancedSpheres {
 public:
-    std::vector<Mesh> stems;
-    std::vector<glm::vec3> basePositions;
-    std::vector<float> swayOffsets;
+    std::vector<Mesh>* levels; // LOD lanac, 0 = najdetaljniji
+    InstanceBuffer buffer;
+    std::vector<SphereInstance> instances;
 
-    AlgaeBush(glm::vec3 center, int count = 20)
+    InstancedSpheres(std::vector<Mesh>* levels) : levels(levels)
     {
-        for (int i = 0; i < count; i++)
-        {
-            float offsetX = ((rand() % 100) / 100.0f - 0.5f) * 0.75f;
-            float offsetZ = ((rand() % 100) / 100.0f - 0.5f) * 0.75f;
+        buffer.create(sizeof(SphereInstance), {
+            { 3, 4, offsetof(SphereInstance, position) },
+            { 4, 1, offsetof(SphereInstance, alpha) }
+        });
+        for (size_t& first : attachedFirst)
+            first = (size_t)-1;
+    }
 
-            float height = 1.75f + ((rand() % 100) / 100.0f) * 1.75f;  
-            float width = 0.03f + ((rand() % 100) / 100.0f) * 0.02f; // 0.03 - 0.05
+    void clear()
+    {
+        instances.clear();
+    }
+
+    void add(const glm::vec3& position, float radius, float alpha)
+    {
+        instances.push_back({ position, radius, alpha });
+    }
+
+    // Instance van frustuma se izbacuju pojedinacno, ostale dobijaju LOD nivo po velicini na ekranu i
+    // grupisu se po nivou u isti bafer; svaki nivo je jedan poziv u redu.
+    // Centar vidljivih instanci sluzi za sortiranje po dubini.
+    void submit(RenderQueue& queue, const LodSelector& lod, Shader& shader, const glm::vec4& color, RenderPass pass)
+    {
+        size_t visible = 0;
+        for (size_t i = 0; i < instances.size(); i++) {
+            if (queue.isVisible({ instances[i].position, instances[i].radius }))
+                instances[visible++] = instances[i];
+        }
+        instances.resize(visible);
 
-            stems.push_back(createCylinderMesh(height, width, 12));
+        if (instances.empty()) return;
 
-            basePositions.push_back(glm::vec3(center.x + offsetX, 0.0f, center.z + offsetZ));
+        int levelCount = (int)levels->size();
+        instanceLevels.resize(instances.size());
+        glm::vec3 center(0.0f);
+        for (size_t i = 0; i < instances.size(); i++) {
+            instanceLevels[i] = lod.select(instances[i].position, instances[i].radius, levelCount);
+            center += instances[i].position;
+        }
+        center /= (float)instances.size();
+
+        groupByLod(instances, instanceLevels, grouped, ranges);
+        buffer.upload(grouped.data(), grouped.size());
 
-            swayOffsets.push_back(((rand() % 100) / 100.0f) * 3.14f * 10.0f); // random faza
+        for (int level = 0; level < levelCount; level++) {
+            if (ranges[level].count == 0) continue;
+
+            // GL 3.3 nema base instance, pa VAO svakog nivoa pokazuje na svoj deo bafera preko offseta atributa
+            Mesh& mesh = (*levels)[level];
+            if (attachedFirst[level] != ranges[level].first) {
+                buffer.attach(mesh.VAO, ranges[level].first);
+                attachedFirst[level] = ranges[level].first;
+            }
+
+            DrawItem item;
+            item.pass = pass;
+            item.shader = &shader;
+            item.mesh = &mesh;
+            item.instanceCount = (GLsizei)ranges[level].count;
+            item.color = color;
+            item.hasColor = true;
+            item.center = center;
+            queue.submit(item);
         }
     }
 
-    void Draw(Shader& shader, float time)
+private:
+    std::vector<int> instanceLevels;
+    std::vector<SphereInstance> grouped;
+    LodRange ranges[LOD_LEVELS];
+    size_t attachedFirst[LOD_LEVELS]; // prvi instance na koji je VAO nivoa trenutno povezan
+};
+
+// Mehurici svih riba u jednom bazenu fiksnog kapaciteta, kao struktura nizova (SoA): svako polje je poseban niz,
+// pa petlje azuriranja idu redom kroz susedne float-ove i kompajler ih moze vektorizovati.
+// Njisanje zato ne zove sin po mehuru: faza se cuva kao (sin, cos) i svaki korak rotira za isti ugao,
+// ciji se sin i cos racunaju jednom izvan petlje, pa u petlji ostaju samo mnozenja i sabiranja.
+// Redosled mehurica nije bitan, pa se mehur uklanja u O(1) tako sto na njegovo mesto dodje poslednji (swap-and-pop).
+class BubbleSystem {
+public:
+    size_t capacity;
+
+    // Zajednicko za sve mehurice
+    float driftAmplitude = 0.1f;
+    float opacity = 0.7f;
+
+    size_t dropped = 0; // mehurici koji nisu stali u pun bazen
+
+    // Podrazumevani kapacitet pokriva 100k mehurica za koje je pravljen instancirani put (InstancedSpheres);
+    // nizovi se zauzmu jednom ovde, pa spawn nikad ne alocira
+    BubbleSystem(size_t capacity = 100000) : capacity(capacity)
     {
-        shader.use();
-        shader.setVec4("uColor", glm::vec4(0.0f, 0.7f, 0.2f, 1.0f));
+        for (std::vector<float>* field : { &x, &y, &z, &previousX, &previousY, &speeds, &radii, &phaseSin, &phaseCos })
+            field->resize(capacity);
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    void spawn(const glm::vec3& position, float speed, float radius)
+    {
+        if (count == capacity) {
+            dropped++;
+            return;
+        }
+
+        x[count] = previousX[count] = position.x;
+        y[count] = previousY[count] = position.y;
+        z[count] = position.z;
+        speeds[count] = speed;
+        radii[count] = radius;
+        phaseSin[count] = 0.0f;
+        phaseCos[count] = 1.0f;
+        count++;
+    }
+
+    // Jedan korak simulacije: mehurici se dizu i njisu levo-desno, a iznad vode nestaju
+    void update(float deltaTime, float maxY)
+    {
+        float* px = x.data();
+        float* py = y.data();
+        float* prevX = previousX.data();
+        float* prevY = previousY.data();
+        const float* speed = speeds.data();
+        float* sinPhase = phaseSin.data();
+        float* cosPhase = phaseCos.data();
+
+        // z se ne menja, pa se za interpolaciju pamte samo x i y
+        for (size_t i = 0; i < count; i++) {
+            prevX[i] = px[i];
+            prevY[i] = py[i];
+        }
 
-        for (int i = 0; i < stems.size(); i++)
+        // faza raste za 2 * deltaTime: sin(a + d) = sin a cos d + cos a sin d, cos(a + d) = cos a cos d - sin a sin d
+        float stepSin = std::sin(deltaTime * 2.0f);
+        float stepCos = std::cos(deltaTime * 2.0f);
+        float driftScale = driftAmplitude * deltaTime * 4.0f;
+
+        for (size_t i = 0; i < count; i++) {
+            float s = sinPhase[i] * stepCos + cosPhase[i] * stepSin;
+            float c = cosPhase[i] * stepCos - sinPhase[i] * stepSin;
+            sinPhase[i] = s;
+            cosPhase[i] = c;
+            py[i] += speed[i] * deltaTime;
+            px[i] += s * driftScale;
+        }
+
+        size_t i = 0;
+        while (i < count) {
+            if (py[i] > maxY)
+                removeAt(i); // na mesto i dolazi poslednji mehur, pa se i ne pomera
+            else
+                i++;
+        }
+    }
+
+    // Upisuje mehurice u instancirani batch, interpolirane izmedju poslednja dva koraka simulacije
+    void collect(InstancedSpheres& batch, float alpha) const
+    {
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 position(glm::mix(previousX[i], x[i], alpha), glm::mix(previousY[i], y[i], alpha), z[i]);
+            batch.add(position, radii[i], opacity);
+        }
+    }
+
+private:
+    size_t count = 0;
+    std::vector<float> x, y, z;
+    std::vector<float> previousX, previousY;
+    std::vector<float> speeds, radii;
+    std::vector<float> phaseSin, phaseCos; // sin i cos faze njisanja
+
+    void removeAt(size_t i)
+    {
+        size_t last = --count;
+        x[i] = x[last];
+        y[i] = y[last];
+        z[i] = z[last];
+        previousX[i] = previousX[last];
+        previousY[i] = previousY[last];
+        speeds[i] = speeds[last];
+        radii[i] = radii[last];
+        phaseSin[i] = phaseSin[last];
+        phaseCos[i] = phaseCos[last];
+    }
+};
+
+// Jedna stabljika algi kao instanca jedinicnog valjka; njisanje racuna vertex sejder (algae.vert)
+struct AlgaeInstance {
+    glm::vec3 basePosition;
+    float height;
+    float width;
+    float swayOffset;
+};
+
+class AlgaeBush {
+public:
+    std::vector<AlgaeInstance> stems;
+
+    AlgaeBush(glm::vec3 center, int count = 20)
+    {
+        for (int i = 0; i < count; i++)
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, basePositions[i]);
+            float offsetX = ((rand() % 100) / 100.0f - 0.5f) * 0.75f;
+            float offsetZ = ((rand() % 100) / 100.0f - 0.5f) * 0.75f;
+
+            float height = 1.75f + ((rand() % 100) / 100.0f) * 1.75f;  
+            float width = 0.03f + ((rand() % 100) / 100.0f) * 0.02f; // 0.03 - 0.05
 
-            // Lagano njišenje stabljike
-            float sway = sin(time + swayOffsets[i]) * 0.2f; // amplitude
-            model = glm::rotate(model, sway, glm::vec3(0, 0, 1)); // njiši po Z osi
+            AlgaeInstance stem;
+            stem.basePosition = glm::vec3(center.x + offsetX, 0.0f, center.z + offsetZ);
+            stem.height = height;
+            stem.width = width;
+            stem.swayOffset = ((rand() % 100) / 100.0f) * 3.14f * 10.0f; // random faza
 
-            shader.setMat4("model", model);
-            stems[i].Draw(shader);
+            stems.push_back(stem);
         }
     }
 };
 
+// Varijanta basic/texture sejdera za objekat: tackasta svetla se prevode u program samo za objekte cija je
+// sfera (item.center, item.radius) u dometu nekog svetla, svi ostali crtaju program bez njih
+Shader& lightVariant(ShaderVariants& variants, const ClusteredLights& lights, const DrawItem& item)
+{
+    return variants.get(lights.touches({ item.center, item.radius }) ? POINT_LIGHTS : 0);
+}
+
 class Aquarium {
 public:
-    std::vector<Mesh> glass; // 0: front, 1: back, 2: left, 3: right
-    std::vector<Mesh> frame;
-    Mesh bottom;
+    // Staticki batch-evi: dno i ram su jedan neprovidan mesh, sva cetiri stakla jedan providan,
+    // sa vec transformisanim verteksima, pa se ceo akvarijum crta u dva poziva
+    Mesh shell;
+    Mesh glass;
     Mesh sand;
     AquariumBounds bounds;
     AlgaeBush algaeBush1;
     AlgaeBush algaeBush2;
 
-    Aquarium() : bottom(createCubeMesh(glm::vec3(tankWidth, wallThickness, tankDepth), false)), sand(createSandMeshFilled(sandRows, sandCols, sandWidth, sandDepth, sandHeight)), algaeBush1(AlgaeBush(glm::vec3(-tankWidth / 4, sandHeight, -tankDepth / 4), 25)), algaeBush2(AlgaeBush(glm::vec3(tankWidth / 4, sandHeight, tankDepth / 5), 30)) {
+    // Sve stabljike svih zbunova dele jedinicni valjak (LOD lanac) i crtaju se jednim instanciranim pozivom po nivou
+    std::vector<Mesh> algaeLods;
+    std::vector<AlgaeInstance> algaeStems;
+    InstanceBuffer algaeInstances;
+    std::vector<int> algaeLevels;                          // nivo svake stabljike koji je trenutno u baferu
+    LodRange algaeRanges[LOD_LEVELS];
+    glm::vec3 algaeMin[LOD_LEVELS], algaeMax[LOD_LEVELS];  // obuhvataju stabljike nivoa u bilo kom polozaju njisanja
+
+    Aquarium() : shell(buildShellMeshData()), glass(buildGlassMeshData()), sand(createSandMeshFilled(sandRows, sandCols, sandWidth, sandDepth, sandHeight)), algaeBush1(AlgaeBush(glm::vec3(-tankWidth / 4, sandHeight, -tankDepth / 4), 25)), algaeBush2(AlgaeBush(glm::vec3(tankWidth / 4, sandHeight, tankDepth / 5), 30)), algaeLods(createCylinderLodChain(1.0f, 1.0f, 12)) {
+        setupAlgae();
+        computeBounds();
+    }
+
+    // Dno + cetiri stuba rama u jednom mesh-u
+    static MeshData buildShellMeshData()
+    {
+        MeshData data;
+
+        appendMeshData(data, buildCubeMeshData(glm::vec3(tankWidth, wallThickness, tankDepth), false),
+            glm::translate(glm::mat4(1.0f), glm::vec3(0, -wallThickness / 2, 0)));
+
+        float bw = wallThickness;
+        float bh = tankHeight;
+        float bd = wallThickness;
+        MeshData pillar = buildCubeMeshData(glm::vec3(bw, bh, bd), false);
+
+        float x = tankWidth / 2 - wallThickness / 2;
+        float z = tankDepth / 2 - wallThickness / 2;
+        float y = tankHeight / 2;
+
+        appendMeshData(data, pillar, glm::translate(glm::mat4(1.0f), glm::vec3(-x, y, -z))); // front-left
+        appendMeshData(data, pillar, glm::translate(glm::mat4(1.0f), glm::vec3(x, y, -z)));  // front-right
+        appendMeshData(data, pillar, glm::translate(glm::mat4(1.0f), glm::vec3(-x, y, z)));  // back-left
+        appendMeshData(data, pillar, glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z)));   // back-right
+
+        return data;
+    }
+
+    // Stakla u istom redosledu u kom su se ranije crtala: zadnje, levo, desno, prednje
+    static MeshData buildGlassMeshData()
+    {
         float gt = wallThickness;
         float gw = tankWidth;
         float gh = tankHeight;
         float gd = tankDepth;
 
-        glass.push_back(createCubeMesh(glm::vec3(gw, gh, gt), false));
-        glass.push_back(createCubeMesh(glm::vec3(gw, gh, gt), false));
-        glass.push_back(createCubeMesh(glm::vec3(gt, gh, gd), false));
-        glass.push_back(createCubeMesh(glm::vec3(gt, gh, gd), false));
+        MeshData data;
+        MeshData frontBack = buildCubeMeshData(glm::vec3(gw, gh, gt), false);
+        MeshData side = buildCubeMeshData(glm::vec3(gt, gh, gd), false);
 
-        float bw = wallThickness;
-        float bh = tankHeight;
-        float bd = wallThickness;
+        appendMeshData(data, frontBack, glm::translate(glm::mat4(1.0f),
+            glm::vec3(0, tankHeight / 2, tankDepth / 2 - wallThickness / 2)));   // Back
+        appendMeshData(data, side, glm::translate(glm::mat4(1.0f),
+            glm::vec3(-tankWidth / 2 + wallThickness / 2, tankHeight / 2, 0))); // Left
+        appendMeshData(data, side, glm::translate(glm::mat4(1.0f),
+            glm::vec3(tankWidth / 2 - wallThickness / 2, tankHeight / 2, 0)));  // Right
+        appendMeshData(data, frontBack, glm::translate(glm::mat4(1.0f),
+            glm::vec3(0, tankHeight / 2, -tankDepth / 2 + wallThickness / 2))); // Front
 
-        frame.push_back(createCubeMesh(glm::vec3(bw, bh, bd), false)); // front-left
-        frame.push_back(createCubeMesh(glm::vec3(bw, bh, bd), false)); // front-right
-        frame.push_back(createCubeMesh(glm::vec3(bw, bh, bd), false)); // back-left
-        frame.push_back(createCubeMesh(glm::vec3(bw, bh, bd), false)); // back-right
+        return data;
+    }
 
-        computeBounds();
+    void setupAlgae()
+    {
+        algaeStems = algaeBush1.stems;
+        algaeStems.insert(algaeStems.end(), algaeBush2.stems.begin(), algaeBush2.stems.end());
+
+        // Bafer se puni tek kada se prvi put odrede LOD nivoi (updateAlgaeLods)
+        algaeInstances.create(sizeof(AlgaeInstance), {
+            { 3, 3, offsetof(AlgaeInstance, basePosition) },
+            { 4, 3, offsetof(AlgaeInstance, height) }
+        });
+    }
+
+    // Broj segmenata zavisi od obima, pa se nivo bira po sirini stabljike na ekranu.
+    // Podaci stabljika se ne menjaju, pa se bafer ponovo salje samo kada neka stabljika promeni nivo.
+    void updateAlgaeLods(const LodSelector& lod)
+    {
+        int levelCount = (int)algaeLods.size();
+        std::vector<int> levels(algaeStems.size());
+        for (size_t i = 0; i < algaeStems.size(); i++) {
+            const AlgaeInstance& stem = algaeStems[i];
+            levels[i] = lod.select(stem.basePosition + glm::vec3(0.0f, stem.height / 2, 0.0f), stem.width, levelCount);
+        }
+        if (levels == algaeLevels) return;
+        algaeLevels = levels;
+
+        std::vector<AlgaeInstance> grouped;
+        groupByLod(algaeStems, algaeLevels, grouped, algaeRanges);
+        algaeInstances.upload(grouped.data(), grouped.size(), GL_DYNAMIC_DRAW);
+
+        for (int level = 0; level < levelCount; level++) {
+            const LodRange& range = algaeRanges[level];
+            if (range.count == 0) continue;
+
+            // Stabljika se okrece oko svoje osnove, pa je uvek unutar sfere oko sredine stabljike
+            algaeMin[level] = glm::vec3(FLT_MAX);
+            algaeMax[level] = glm::vec3(-FLT_MAX);
+            for (size_t i = range.first; i < range.first + range.count; i++) {
+                glm::vec3 middle = grouped[i].basePosition + glm::vec3(0.0f, grouped[i].height / 2, 0.0f);
+                float reach = grouped[i].height / 2 + grouped[i].width;
+                algaeMin[level] = glm::min(algaeMin[level], middle - glm::vec3(reach));
+                algaeMax[level] = glm::max(algaeMax[level], middle + glm::vec3(reach));
+            }
+
+            algaeInstances.attach(algaeLods[level].VAO, range.first);
+        }
     }
 
     void computeBounds()
@@ -698,96 +1038,57 @@ public:
         return bounds;
     }
 
-    void Draw(Shader& basicShader, Shader& sandShader, unsigned int sandTex, float time)
+    void submit(RenderQueue& queue, const LodSelector& lod, ShaderVariants& basicVariants, ShaderVariants& sandVariants,
+        const ClusteredLights& lights, Shader& algaeShader, unsigned int sandTex, float time)
     {
-        bool prevCull = cullFaceEnabled;
-        bool prevDepth = depthTestEnabled;
-
-        glm::mat4 model;
-
-        basicShader.use();
-        basicShader.setVec4("uColor", glm::vec4(0, 0, 0, 1));
-
-        model = glm::translate(glm::mat4(1.0f),
-            glm::vec3(0, -wallThickness / 2, 0));
-        basicShader.setMat4("model", model);
-        bottom.Draw(basicShader);
-
-        algaeBush1.Draw(basicShader, time);
-        algaeBush2.Draw(basicShader, time);
-
-        sandShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, sandTex);
-        model = glm::translate(glm::mat4(1.0f),
-            glm::vec3(0, 0.01f, 0));
-        sandShader.setMat4("model", model);
-        sand.Draw(sandShader);
-
-        basicShader.use();
-        basicShader.setVec4("uColor", glm::vec4(0, 0, 0, 1));
-
-        float x = tankWidth / 2 - wallThickness / 2;
-        float z = tankDepth / 2 - wallThickness / 2;
-        float y = tankHeight / 2;
-
-        //glDisable(GL_CULL_FACE);
-
-        // Front-left
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-x, y, -z));
-        basicShader.setMat4("model", model);
-        frame[0].Draw(basicShader);
-
-        // Front-right
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, -z));
-        basicShader.setMat4("model", model);
-        frame[1].Draw(basicShader);
-
-        // Back-left
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-x, y, z));
-        basicShader.setMat4("model", model);
-        frame[2].Draw(basicShader);
-
-        // Back-right
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
-        basicShader.setMat4("model", model);
-        frame[3].Draw(basicShader);
-
-        basicShader.use();
-        basicShader.setVec4("uColor", glm::vec4(0.6f, 0.8f, 1.0f, 0.2f));
-
-        //if (prevCull) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-
-        glDisable(GL_CULL_FACE);
-        glDepthMask(GL_FALSE);
-
-        // Back
-        model = glm::translate(glm::mat4(1.0f),
-            glm::vec3(0, tankHeight / 2, tankDepth / 2 - wallThickness / 2));
-        basicShader.setMat4("model", model);
-        glass[1].Draw(basicShader);
-
-        // Left
-        model = glm::translate(glm::mat4(1.0f),
-            glm::vec3(-tankWidth / 2 + wallThickness / 2, tankHeight / 2, 0));
-        basicShader.setMat4("model", model);
-        glass[2].Draw(basicShader);
-
-        // Right
-        model = glm::translate(glm::mat4(1.0f),
-            glm::vec3(tankWidth / 2 - wallThickness / 2, tankHeight / 2, 0));
-        basicShader.setMat4("model", model);
-        glass[3].Draw(basicShader);
-
-        // Front
-        model = glm::translate(glm::mat4(1.0f),
-            glm::vec3(0, tankHeight / 2, -tankDepth / 2 + wallThickness / 2));
-        basicShader.setMat4("model", model);
-        glass[0].Draw(basicShader);
+        glm::mat4 identity = glm::mat4(1.0f);
+
+        // Batch-evi su vec u svetskim koordinatama, pa im je model jedinicna matrica
+        DrawItem shellItem;
+        shellItem.mesh = &shell;
+        shellItem.color = glm::vec4(0, 0, 0, 1);
+        shellItem.hasColor = true;
+        shellItem.setBounds(transformBounds(shell.minBounds, shell.maxBounds, identity));
+        shellItem.shader = &lightVariant(basicVariants, lights, shellItem);
+        queue.submit(shellItem);
+
+        // Vreme njisanja je isto za sve stabljike
+        algaeShader.use();
+        algaeShader.setFloat("uTime", time);
+
+        updateAlgaeLods(lod);
+        for (size_t level = 0; level < algaeLods.size(); level++) {
+            if (algaeRanges[level].count == 0) continue;
+
+            DrawItem algaeItem;
+            algaeItem.shader = &algaeShader;
+            algaeItem.mesh = &algaeLods[level];
+            algaeItem.instanceCount = (GLsizei)algaeRanges[level].count;
+            algaeItem.color = glm::vec4(0.0f, 0.7f, 0.2f, 1.0f);
+            algaeItem.hasColor = true;
+            algaeItem.setBounds(transformBounds(algaeMin[level], algaeMax[level], identity));
+            queue.submit(algaeItem);
+        }
 
-        glDepthMask(GL_TRUE);
-        if (prevCull) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-        if (prevDepth) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
+        DrawItem sandItem;
+        sandItem.mesh = &sand;
+        sandItem.texture = sandTex;
+        sandItem.model = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0.01f, 0));
+        sandItem.setBounds(transformBounds(sand.minBounds, sand.maxBounds, sandItem.model));
+        sandItem.shader = &lightVariant(sandVariants, lights, sandItem);
+        queue.submit(sandItem);
+
+        // Staklo je providno: crta se posle svih neprovidnih objekata, bez pisanja u depth bafer
+        DrawItem glassItem;
+        glassItem.pass = PASS_TRANSPARENT;
+        glassItem.mesh = &glass;
+        glassItem.color = glm::vec4(0.6f, 0.8f, 1.0f, 0.2f);
+        glassItem.hasColor = true;
+        glassItem.cullFace = false;
+        glassItem.depthWrite = false;
+        glassItem.setBounds(transformBounds(glass.minBounds, glass.maxBounds, identity));
+        glassItem.shader = &lightVariant(basicVariants, lights, glassItem);
+        queue.submit(glassItem);
     }
 };
 
@@ -805,6 +1106,7 @@ public:
 
     glm::vec3 position;
     float lidAngle = 0.0f; // 0 = zatvoren, >0 = otvoren
+    float previousLidAngle = 0.0f;
     bool opening = false;
 
     struct AABB {
@@ -857,6 +1159,7 @@ public:
 
     void update(float deltaTime)
     {
+        previousLidAngle = lidAngle;
         if (opening && lidAngle < glm::radians(110.0f))
             lidAngle += deltaTime * glm::radians(60.0f);
         else if (!opening && lidAngle > 0.0f)
@@ -868,116 +1171,109 @@ public:
         opening = !opening;
     }
 
-    void draw(Shader& textureShader, Shader& basicShader)
+    // Centri dragulja i novcica u kovcegu (ujedno i pozicije treasure svetala)
+    void getTreasureCenters(glm::vec3& gemCenter, glm::vec3& coin1Center, glm::vec3& coin2Center) const
     {
         float innerBackZ = position.z - depth / 2 + wallThickness + 0.05f;
         float bottomY = position.y + wallThickness + 0.075f;
 
+        gemCenter = glm::vec3(position.x, bottomY + 0.2f, innerBackZ + 0.2f);
+        coin1Center = glm::vec3(position.x - width * 0.3f, bottomY + 0.05f, innerBackZ + 0.075f);
+        coin2Center = glm::vec3(position.x + width * 0.25f, bottomY + 0.15f, innerBackZ + 0.05f);
+    }
+
+    // Otvoren kovceg dodaje svoja treasure svetla (dragulj i dva novcica) u listu tackastih svetala scene
+    void collectLights(std::vector<PointLight>& lights) const
+    {
+        if (lidAngle <= glm::radians(1.0f))
+            return;
+
+        glm::vec3 gemCenter, coin1Center, coin2Center;
+        getTreasureCenters(gemCenter, coin1Center, coin2Center);
+
+        const float intensity = 0.05f;
+        const float radius = pointLightRadius(intensity);
+        glm::vec3 gemColor(0.0f, 0.8f, 1.0f);
+        glm::vec3 coinColor(1.0f, 0.84f, 0.0f);
+
+        lights.push_back({ gemCenter, radius, gemColor, intensity });
+        lights.push_back({ coin1Center, radius, coinColor, intensity });
+        lights.push_back({ coin2Center, radius, coinColor, intensity });
+    }
+
+    // alpha: udeo koraka simulacije za interpolaciju poklopca (FixedTimestep::alpha)
+    void submit(RenderQueue& queue, ShaderVariants& textureVariants, ShaderVariants& basicVariants, const ClusteredLights& lights, float alpha)
+    {
         // --- Treasure light aktivno za kovčeg ---
-        glm::vec3 gemCenter = glm::vec3(position.x, bottomY + 0.2f, innerBackZ + 0.2f);
-        glm::vec3 gemColor = glm::vec3(0.0f, 0.8f, 1.0f); 
-        float gemIntensity = 0.05f;
-
-        glm::vec3 coin1Center = glm::vec3(position.x - width * 0.3f, bottomY + 0.05f, innerBackZ + 0.075f);
-        glm::vec3 coin2Center = glm::vec3(position.x + width * 0.25f, bottomY + 0.15f, innerBackZ + 0.05f);
-        glm::vec3 coinColor = glm::vec3(1.0f, 0.84f, 0.0f);
-        float coinIntensity = 0.05f;
-
-        if (lidAngle > glm::radians(1.0f)) {
-            basicShader.use();
-            basicShader.setBool("uTreasureLightEnabled", true);
-            basicShader.setVec3("uGemLightPos", gemCenter);
-            basicShader.setVec3("uGemLightColor", gemColor);
-            basicShader.setFloat("uGemLightIntensity", gemIntensity);
-
-            basicShader.setVec3("uCoin1LightPos", coin1Center);
-            basicShader.setVec3("uCoin2LightPos", coin2Center);
-            basicShader.setVec3("uCoinLightColor", coinColor);
-            basicShader.setFloat("uCoinLightIntensity", coinIntensity);
+        bool treasureLight = lidAngle > glm::radians(1.0f);
+
+        auto submitPart = [&](ShaderVariants& variants, Mesh& mesh, const glm::mat4& model, const glm::vec4* color) {
+            DrawItem item;
+            item.mesh = &mesh;
+            item.model = model;
+            if (color) {
+                item.color = *color;
+                item.hasColor = true;
+            }
+            item.setBounds(transformBounds(mesh.minBounds, mesh.maxBounds, model));
+            item.shader = &lightVariant(variants, lights, item);
+            queue.submit(item);
+        };
+
+        if (treasureLight) {
+            glm::vec3 gemCenter, coin1Center, coin2Center;
+            getTreasureCenters(gemCenter, coin1Center, coin2Center);
+
+            glm::vec4 gold(1.0f, 0.84f, 0.0f, 1.0f);
+            glm::vec4 cyan(0.0f, 0.8f, 1.0f, 1.0f);
 
             // Coin 1
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(glm::mat4(1.0f), coin1Center);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), coin1Center);
             model = glm::rotate(model, glm::radians(60.0f), glm::vec3(1, 0, 0));
             model = glm::scale(model, glm::vec3(1.5f));
-            basicShader.setMat4("model", model);
-            basicShader.setVec4("uColor", glm::vec4(1.0f, 0.84f, 0.0f, 1.0f));
-            coin.Draw(basicShader);
+            submitPart(basicVariants, coin, model, &gold);
 
             // Coin 2
             model = glm::translate(glm::mat4(1.0f), coin2Center);
             model = glm::rotate(model, glm::radians(75.0f), glm::vec3(1, 0, 0));
             model = glm::scale(model, glm::vec3(1.5f));
-            basicShader.setMat4("model", model);
-            basicShader.setVec4("uColor", glm::vec4(1.0f, 0.84f, 0.0f, 1.0f));
-            coin.Draw(basicShader);
+            submitPart(basicVariants, coin, model, &gold);
 
             // Gem
             model = glm::translate(glm::mat4(1.0f), gemCenter);
             model = glm::rotate(model, glm::radians(78.0f), glm::vec3(1, 0, 0));
             model = glm::scale(model, glm::vec3(1.5f));
-            basicShader.setMat4("model", model);
-            basicShader.setVec4("uColor", glm::vec4(0.0f, 0.8f, 1.0f, 1.0f));
-            gem.Draw(basicShader);
-
-            // --- Isključi treasure light ---
-            basicShader.setBool("uTreasureLightEnabled", false);
-
-            textureShader.use();
-            textureShader.setBool("uTreasureLightEnabled", true);
-            textureShader.setVec3("uGemLightPos", gemCenter);
-            textureShader.setVec3("uGemLightColor", gemColor);
-            textureShader.setFloat("uGemLightIntensity", gemIntensity);
-
-            textureShader.setVec3("uCoin1LightPos", coin1Center);
-            textureShader.setVec3("uCoin2LightPos", coin2Center);
-            textureShader.setVec3("uCoinLightColor", coinColor);
-            textureShader.setFloat("uCoinLightIntensity", coinIntensity);
+            submitPart(basicVariants, gem, model, &cyan);
         }
 
         // --- Telo kovčega ---
 
         // Back
-        textureShader.use();
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(glm::mat4(1.0f),
-            position + glm::vec3(0, height / 2, depth / 2 - this->wallThickness / 2));
-        textureShader.setMat4("model", model);
-        sides[1].Draw(textureShader);
+        submitPart(textureVariants, sides[1], glm::translate(glm::mat4(1.0f),
+            position + glm::vec3(0, height / 2, depth / 2 - this->wallThickness / 2)), nullptr);
 
         // Left
-        model = glm::translate(glm::mat4(1.0f),
-            position + glm::vec3(-width / 2 + this->wallThickness / 2, height / 2, 0));
-        textureShader.setMat4("model", model);
-        sides[2].Draw(textureShader);
+        submitPart(textureVariants, sides[2], glm::translate(glm::mat4(1.0f),
+            position + glm::vec3(-width / 2 + this->wallThickness / 2, height / 2, 0)), nullptr);
 
         // Right
-        model = glm::translate(glm::mat4(1.0f),
-            position + glm::vec3(width / 2 - this->wallThickness / 2, height / 2, 0));
-        textureShader.setMat4("model", model);
-        sides[3].Draw(textureShader);
+        submitPart(textureVariants, sides[3], glm::translate(glm::mat4(1.0f),
+            position + glm::vec3(width / 2 - this->wallThickness / 2, height / 2, 0)), nullptr);
 
         // Front
-        model = glm::translate(glm::mat4(1.0f),
-            position + glm::vec3(0, height / 2, -depth / 2 + this->wallThickness / 2));
-        textureShader.setMat4("model", model);
-        sides[0].Draw(textureShader);
+        submitPart(textureVariants, sides[0], glm::translate(glm::mat4(1.0f),
+            position + glm::vec3(0, height / 2, -depth / 2 + this->wallThickness / 2)), nullptr);
 
         // Bottom
-        model = glm::translate(glm::mat4(1.0f),
-            position + glm::vec3(0, this->wallThickness / 2, 0));
-        textureShader.setMat4("model", model);
-        sides[4].Draw(textureShader);
+        submitPart(textureVariants, sides[4], glm::translate(glm::mat4(1.0f),
+            position + glm::vec3(0, this->wallThickness / 2, 0)), nullptr);
 
         // --- Poklopac ---
         glm::mat4 lidModel = glm::mat4(1.0f);
         lidModel = glm::translate(lidModel, position + glm::vec3(0.0f, height, -depth / 2.0f)); // šarka pozadi
-        lidModel = glm::rotate(lidModel, -lidAngle, glm::vec3(1, 0, 0));
+        lidModel = glm::rotate(lidModel, -glm::mix(previousLidAngle, lidAngle, alpha), glm::vec3(1, 0, 0));
         lidModel = glm::translate(lidModel, glm::vec3(0.0f, 0.1f, 0.5f)); // pomeraj da se poklopac lepo rotira
-
-        textureShader.setMat4("model", lidModel);
-        lid.Draw(textureShader);
-        textureShader.setBool("uTreasureLightEnabled", false);
+        submitPart(textureVariants, lid, lidModel, nullptr);
     }
 
     bool checkFishCollisionWithAABB(glm::vec3 fishPosition, float fishRadius, const Chest::AABB& box)
@@ -1001,14 +1297,46 @@ public:
     float speed;
     float scale;
     glm::vec3 lastHorizontalDir = glm::vec3(0.0f, 0.0f, 1.0f);
-    std::vector<Bubble> bubbles;
+
+    // Stanje pre poslednjeg koraka simulacije; crta se interpolacija izmedju njega i trenutnog
+    glm::vec3 previousPosition;
+    float previousYaw, previousPitch, previousScale;
 
     Fish(Model* model, glm::vec3 startPos, glm::vec3 baseRotation, float speed = 3.0f, float scale = 1.0f) : model(model), position(startPos), baseRotation(baseRotation), speed(speed), scale(scale)
     {
         direction = glm::vec3(0.0f, 0.0f, 1.0f);
+        modelRadius = glm::length(model->maxBounds - model->minBounds) * 0.5f;
+        savePreviousState();
     }
 
-    void emitBubbles()
+    // Poluprecnik sfere oko ribe; granice modela se ne menjaju, pa se njihova duzina racuna jednom
+    float radius() const
+    {
+        return modelRadius * scale;
+    }
+
+    float yawAngle() const
+    {
+        return atan2(-lastHorizontalDir.z, lastHorizontalDir.x);
+    }
+
+    float pitchAngle() const
+    {
+        if (glm::length(direction) > 0.001f)
+            return direction.y * glm::radians(25.0f);
+        return 0.0f;
+    }
+
+    void savePreviousState()
+    {
+        previousPosition = position;
+        previousYaw = yawAngle();
+        previousPitch = pitchAngle();
+        previousScale = scale;
+    }
+
+    // Ispusta tri mehurica ispred usta ribe u zajednicki BubbleSystem
+    void emitBubbles(BubbleSystem& bubbles)
     {
         glm::vec3 forward = glm::normalize(lastHorizontalDir);
         glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -1021,29 +1349,30 @@ public:
         float worldXSpread = 0.15f; // dodatni X spread za vizuelni efekat
 
         for (int i = 0; i < 3; i++) {
-            Bubble b;
-
             float lateralOffset = ((rand() % 100) / 100.0f - 0.5f) * 2.0f * lateralSpread;
             float worldXOffset = ((rand() % 100) / 100.0f - 0.5f) * 2.0f * worldXSpread;
 
-            b.position = position
+            glm::vec3 bubblePosition = position
                 + forward * mouthOffset
                 + right * lateralOffset
                 + up * verticalOffset
                 + glm::vec3(worldXOffset, 0.0f, 0.0f);
 
-            b.speed = 0.8f + (rand() % 100) / 200.0f;
+            float bubbleSpeed = 0.8f + (rand() % 100) / 200.0f;
 
             float baseRadius = 0.075f;
             float variation = 0.02f;
-            b.radius = baseRadius + ((rand() % 100) / 100.0f - 0.5f) * 2.0f * variation;
+            float bubbleRadius = baseRadius + ((rand() % 100) / 100.0f - 0.5f) * 2.0f * variation;
 
-            bubbles.push_back(b);
+            bubbles.spawn(bubblePosition, bubbleSpeed, bubbleRadius);
         }
     }
 
+    // Jedan korak simulacije fiksne duzine (FixedTimestep)
     void update(float deltaTime, glm::vec3 inputDir, AquariumBounds bounds, Chest& chest)
     {
+        savePreviousState();
+
         if (glm::length(inputDir) > 0.001f)
         {
             if (abs(direction.x) > 0.001f || abs(direction.z) > 0.001f)
@@ -1072,9 +1401,7 @@ public:
             Chest::AABB lidBox = chest.getLidAABB();
 
             // Uzmemo centar ribe i njen "radius"
-            glm::vec3 size = this->model->maxBounds - this->model->minBounds;
-            float baseRadius = glm::length(size) * 0.5f;
-            float fishRadius = baseRadius * this->scale;
+            float fishRadius = radius();
 
             if (chest.checkFishCollisionWithAABB(proposedPos, fishRadius, bodyBox) ||
                 chest.checkFishCollisionWithAABB(proposedPos, fishRadius, lidBox)) {
@@ -1087,73 +1414,382 @@ public:
         {
             direction = glm::vec3(0.0f);
         }
+    }
+
+    // alpha = 1 je trenutno stanje simulacije, manje vrednosti interpoliraju ka prethodnom koraku
+    glm::mat4 getModelMatrix(float alpha = 1.0f) const
+    {
+        glm::mat4 modelMat = glm::mat4(1.0f);
+        modelMat = glm::translate(modelMat, glm::mix(previousPosition, position, alpha));
+
+        modelMat = glm::rotate(modelMat, mixAngle(previousYaw, yawAngle(), alpha), glm::vec3(0.0f, 1.0f, 0.0f));
+        modelMat = glm::rotate(modelMat, glm::mix(previousPitch, pitchAngle(), alpha), glm::vec3(0.0f, 0.0f, 1.0f));
 
-        for (int i = 0; i < bubbles.size(); i++) {
-            bubbles[i].driftPhase += deltaTime * 2.0f;
+        modelMat = glm::rotate(modelMat, glm::radians(baseRotation.x), glm::vec3(1, 0, 0));
+        modelMat = glm::rotate(modelMat, glm::radians(baseRotation.y), glm::vec3(0, 1, 0));
+        modelMat = glm::rotate(modelMat, glm::radians(baseRotation.z), glm::vec3(0, 0, 1));
 
-            float drift = sin(bubbles[i].driftPhase) * bubbles[i].driftAmplitude * deltaTime;
+        modelMat = glm::scale(modelMat, glm::vec3(glm::mix(previousScale, scale, alpha)));
 
-            bubbles[i].position.y += bubbles[i].speed * deltaTime;
-            bubbles[i].position.x += drift * 4.0f;
+        return modelMat;
+    }
 
-            if (bubbles[i].position.y > bounds.maxY) {
-                bubbles.erase(bubbles.begin() + i);
-                i--;
-            }
+    // Svaki mesh modela je poseban poziv u redu; ako ceo model nije u frustumu, ne proveravaju se ni njegovi mesh-evi
+    void submit(RenderQueue& queue, Shader& shader, float alpha)
+    {
+        glm::mat4 modelMat = getModelMatrix(alpha);
+        if (!queue.isVisible(transformBounds(model->minBounds, model->maxBounds, modelMat))) return;
+
+        for (Mesh& mesh : model->meshes) {
+            DrawItem item;
+            item.shader = &shader;
+            item.mesh = &mesh;
+            item.model = modelMat;
+            item.setBounds(transformBounds(mesh.minBounds, mesh.maxBounds, modelMat));
+            queue.submit(item);
         }
     }
 
-    void draw(Shader& shader)
+private:
+    float modelRadius;
+};
+
+// Jato riba kojima upravlja AI (boids: razdvajanje, poravnanje, kohezija i izbegavanje zidova akvarijuma).
+// Stanje je struktura nizova: svako polje svih riba je poseban niz, a susedi se traze kroz SpatialHash, pa
+// riba proverava samo ribe iz celija oko sebe, a ne celo jato. Uzimaju se svi susedi u dometu opazanja
+// (bez ogranicenja broja), pa cena koraka raste sa gustinom jata.
+// Igraci su posebni clanovi istog sistema: njihove slotove ne pomera AI vec Fish (unos, kolizija sa
+// kovcegom), a ostale ribe ih vide kao susede i sklanjaju im se s puta.
+class FishSchool {
+public:
+    // Vrsta ribe: deli model sa igracem, a sve njene AI ribe se crtaju instancirano
+    struct Species {
+        Model* model;
+        glm::mat4 localTransform; // osnovna rotacija i skala modela
+        InstanceBuffer instances;
+        std::vector<unsigned int> vertexArrays; // sopstveni VAO po mesh-u modela, sa atributima instanci
+        std::vector<glm::mat4> matrices;
+    };
+
+    // Parametri ponasanja
+    float perceptionRadius = 0.8f;
+    float separationRadius = 0.3f;
+    float minSpeed = 0.6f;
+    float maxSpeed = 1.6f;
+    float maxForce = 3.0f;
+    float separationWeight = 1.5f;
+    float alignmentWeight = 1.0f;
+    float cohesionWeight = 0.8f;
+    float wallWeight = 4.0f;
+    float wallMargin = 0.6f;
+
+    // Statistika za benchmark; broje je poslovi sa vise niti
+    std::atomic<size_t> neighbourTests{ 0 };
+
+    FishSchool(const AquariumBounds& bounds)
+        : bounds(bounds),
+          grid(glm::vec3(bounds.minX, bounds.minY, bounds.minZ), glm::vec3(bounds.maxX, bounds.maxY, bounds.maxZ), perceptionRadius)
     {
-        shader.use();
-        glm::mat4 modelMat = glm::mat4(1.0f);
-        modelMat = glm::translate(modelMat, position);
+    }
 
-        float yawAngle = atan2(-lastHorizontalDir.z, lastHorizontalDir.x);
-        modelMat = glm::rotate(modelMat, yawAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+    ~FishSchool()
+    {
+        for (Species& entry : species) {
+            for (unsigned int vertexArray : entry.vertexArrays)
+                GLState::instance().forgetVertexArray(vertexArray);
+            glDeleteVertexArrays((GLsizei)entry.vertexArrays.size(), entry.vertexArrays.data());
+        }
+    }
 
-        float pitchAngle = 0.0f;
-        if (glm::length(direction) > 0.001f)
-        {
-            pitchAngle = direction.y * glm::radians(25.0f);
+    size_t addSpecies(Model* model, glm::vec3 baseRotation, float scale)
+    {
+        Species entry;
+        entry.model = model;
+        entry.localTransform = glm::rotate(glm::mat4(1.0f), glm::radians(baseRotation.x), glm::vec3(1, 0, 0));
+        entry.localTransform = glm::rotate(entry.localTransform, glm::radians(baseRotation.y), glm::vec3(0, 1, 0));
+        entry.localTransform = glm::rotate(entry.localTransform, glm::radians(baseRotation.z), glm::vec3(0, 0, 1));
+        entry.localTransform = glm::scale(entry.localTransform, glm::vec3(scale));
+
+        // mat4 po instanci zauzima cetiri uzastopne lokacije, svaka po jednu kolonu
+        entry.instances.create(sizeof(glm::mat4), {
+            { 3, 4, 0 },
+            { 4, 4, sizeof(glm::vec4) },
+            { 5, 4, 2 * sizeof(glm::vec4) },
+            { 6, 4, 3 * sizeof(glm::vec4) }
+        });
+        // Atributi instanci idu na zasebne VAO-e koji dele bafere mesh-a; VAO-i modela ostaju kakvi su,
+        // jer njih koriste i obicni (neinstancirani) pozivi igraca
+        for (Mesh& mesh : model->meshes) {
+            entry.vertexArrays.push_back(mesh.createSharedVAO());
+            entry.instances.attach(entry.vertexArrays.back());
         }
-        modelMat = glm::rotate(modelMat, pitchAngle, glm::vec3(0.0f, 0.0f, 1.0f));
 
-        modelMat = glm::rotate(modelMat, glm::radians(baseRotation.x), glm::vec3(1, 0, 0));
-        modelMat = glm::rotate(modelMat, glm::radians(baseRotation.y), glm::vec3(0, 1, 0));
-        modelMat = glm::rotate(modelMat, glm::radians(baseRotation.z), glm::vec3(0, 0, 1));
+        species.push_back(entry);
+        return species.size() - 1;
+    }
 
-        modelMat = glm::scale(modelMat, glm::vec3(scale));
+    void addPlayer(Fish* fish)
+    {
+        addMember(fish->position, fish->direction * fish->speed, PLAYER, fish);
+    }
 
-        shader.setMat4("model", modelMat);
-        model->Draw(shader);
+    // count AI riba vrste na nasumicnim mestima u akvarijumu, sa nasumicnim smerom
+    void spawn(size_t speciesIndex, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 position(
+                bounds.minX + random01() * (bounds.maxX - bounds.minX),
+                bounds.minY + random01() * (bounds.maxY - bounds.minY),
+                bounds.minZ + random01() * (bounds.maxZ - bounds.minZ));
+            glm::vec3 heading(random01() - 0.5f, (random01() - 0.5f) * 0.3f, random01() - 0.5f);
+            if (glm::length(heading) < 0.001f) heading = glm::vec3(1.0f, 0.0f, 0.0f);
+
+            addMember(position, glm::normalize(heading) * (minSpeed + maxSpeed) * 0.5f, (unsigned char)speciesIndex, nullptr);
+        }
     }
 
-    void drawBubbles(Shader& shader, Mesh& bubbleMesh)
+    size_t size() const
     {
-        shader.use();
-        shader.setVec4("uColor", glm::vec4(0.9f, 0.95f, 1.0f, 0.7f));
-
-        for (auto& b : bubbles) {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, b.position);
-            model = glm::scale(model, glm::vec3(b.radius));
-            shader.setMat4("model", model);
-            bubbleMesh.Draw(shader);
+        return positions.size();
+    }
+
+    // Jedan korak simulacije fiksne duzine kao graf poslova: sinhronizacija igraca i mreza suseda, pa sile
+    // i integracija paralelno po ribama. dependencies su poslovi koji pomeraju igrace (Fish::update).
+    // Sile se racunaju samo iz stanja sa pocetka koraka, pa raspodela riba po nitima ne utice na rezultat.
+    JobHandle scheduleUpdate(JobSystem& jobs, float deltaTime, const std::vector<JobHandle>& dependencies)
+    {
+        size_t count = positions.size();
+
+        JobHandle prepared = jobs.schedule([this]() {
+            for (size_t i = 0; i < positions.size(); i++) {
+                if (players[i]) {
+                    positions[i] = players[i]->position;
+                    velocities[i] = players[i]->direction * players[i]->speed;
+                }
+            }
+
+            previousPositions = positions;
+            previousVelocities = velocities;
+
+            grid.build(positions, [](const glm::vec3& position) { return position; });
+        }, dependencies);
+
+        JobHandle steered = jobs.parallelFor(count, 64, [this](size_t begin, size_t end) {
+            size_t tests = 0;
+            for (size_t i = begin; i < end; i++) {
+                if (!players[i])
+                    steering[i] = steer(i, tests);
+            }
+            neighbourTests += tests;
+        }, { prepared });
+
+        return jobs.parallelFor(count, 256, [this, deltaTime](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                integrate(i, deltaTime);
+        }, { steered });
+    }
+
+    // AI ribe van frustuma se izbacuju, a ostale se crtaju jednim instanciranim pozivom po mesh-u vrste.
+    // Matrice i frustum test se racunaju paralelno, u slotove po ribi; bafere puni samo glavna nit (GL).
+    void submit(RenderQueue& queue, Shader& instancedShader, float alpha, JobSystem& jobs)
+    {
+        const Frustum& frustum = queue.getFrustum();
+        transforms.resize(positions.size());
+        visible.resize(positions.size());
+
+        jobs.wait(jobs.parallelFor(positions.size(), 256, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                visible[i] = 0;
+                if (players[i]) continue;
+
+                const Species& entry = species[speciesOf[i]];
+                glm::vec3 position = glm::mix(previousPositions[i], positions[i], alpha);
+                transforms[i] = modelMatrix(position, glm::mix(previousVelocities[i], velocities[i], alpha), entry);
+
+                // ista sfera kao kod igraca (Fish::submit), i za modele ciji centar nije u ishodistu
+                visible[i] = frustum.intersectsSphere(transformBounds(entry.model->minBounds, entry.model->maxBounds, transforms[i]));
+            }
+        }));
+
+        for (Species& entry : species)
+            entry.matrices.clear();
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            if (visible[i])
+                species[speciesOf[i]].matrices.push_back(transforms[i]);
+            else if (!players[i])
+                queue.culledObjects++;
+        }
+
+        for (Species& entry : species) {
+            if (entry.matrices.empty()) continue;
+
+            entry.instances.upload(entry.matrices.data(), entry.matrices.size());
+
+            glm::vec3 center(0.0f);
+            for (const glm::mat4& matrix : entry.matrices)
+                center += glm::vec3(matrix[3]);
+            center /= (float)entry.matrices.size();
+
+            for (size_t m = 0; m < entry.model->meshes.size(); m++) {
+                DrawItem item;
+                item.shader = &instancedShader;
+                item.mesh = &entry.model->meshes[m];
+                item.VAO = entry.vertexArrays[m];
+                item.instanceCount = (GLsizei)entry.matrices.size();
+                item.center = center;
+                queue.submit(item);
+            }
         }
     }
+
+private:
+    static const unsigned char PLAYER = 0xFF; // vrsta igraca: samo se sklanjaju od njega, ne prate ga
+
+    AquariumBounds bounds;
+    SpatialHash grid;
+    std::vector<Species> species;
+
+    // Struktura nizova, jedan element po ribi
+    std::vector<glm::vec3> positions, velocities;
+    std::vector<glm::vec3> previousPositions, previousVelocities;
+    std::vector<glm::vec3> steering;
+    std::vector<unsigned char> speciesOf;
+    std::vector<Fish*> players; // nullptr za AI ribe
+
+    // Interpolirane matrice i rezultat frustum testa po ribi, pune ih poslovi u submit
+    std::vector<glm::mat4> transforms;
+    std::vector<char> visible;
+
+    static float random01()
+    {
+        return (rand() % 1000) / 1000.0f;
+    }
+
+    void integrate(size_t i, float deltaTime)
+    {
+        if (players[i]) return;
+
+        glm::vec3 velocity = velocities[i] + steering[i] * deltaTime;
+        float speed = glm::length(velocity);
+        if (speed > maxSpeed)
+            velocity *= maxSpeed / speed;
+        else if (speed < minSpeed)
+            velocity = speed > 0.0001f ? velocity * (minSpeed / speed) : previousVelocities[i];
+        velocities[i] = velocity;
+
+        positions[i] = glm::clamp(positions[i] + velocity * deltaTime,
+            glm::vec3(bounds.minX, bounds.minY, bounds.minZ), glm::vec3(bounds.maxX, bounds.maxY, bounds.maxZ));
+    }
+
+    void addMember(const glm::vec3& position, const glm::vec3& velocity, unsigned char speciesIndex, Fish* player)
+    {
+        positions.push_back(position);
+        velocities.push_back(velocity);
+        previousPositions.push_back(position);
+        previousVelocities.push_back(velocity);
+        steering.push_back(glm::vec3(0.0f));
+        speciesOf.push_back(speciesIndex);
+        players.push_back(player);
+    }
+
+    // tests broji proverene susede; posao ih sabira pa jednom dodaje u zajednicki brojac
+    glm::vec3 steer(size_t i, size_t& tests) const
+    {
+        glm::vec3 position = positions[i];
+        glm::vec3 separation(0.0f), alignment(0.0f), cohesion(0.0f);
+        int schoolmates = 0;
+        float perception2 = perceptionRadius * perceptionRadius;
+        float separation2 = separationRadius * separationRadius;
+
+        grid.query(position, perceptionRadius, [&](size_t j) {
+            if (j == i) return;
+            tests++;
+
+            glm::vec3 offset = positions[j] - position;
+            float distance2 = glm::dot(offset, offset);
+            if (distance2 > perception2 || distance2 < 1e-8f) return;
+
+            if (distance2 < separation2)
+                separation -= offset / distance2;
+
+            // jato se poravnava i drzi na okupu samo sa svojom vrstom
+            if (speciesOf[j] == speciesOf[i]) {
+                alignment += velocities[j];
+                cohesion += positions[j];
+                schoolmates++;
+            }
+        });
+
+        glm::vec3 force = separation * separationWeight + wallAvoidance(position) * wallWeight;
+        if (schoolmates > 0) {
+            force += (alignment / (float)schoolmates - velocities[i]) * alignmentWeight;
+            force += (cohesion / (float)schoolmates - position) * cohesionWeight;
+        }
+
+        float length = glm::length(force);
+        if (length > maxForce)
+            force *= maxForce / length;
+        return force;
+    }
+
+    // Sila ka unutrasnjosti akvarijuma, raste kako se riba priblizava zidu u pojasu wallMargin
+    glm::vec3 wallAvoidance(const glm::vec3& position) const
+    {
+        glm::vec3 force(0.0f);
+        force.x += std::max(0.0f, bounds.minX + wallMargin - position.x) - std::max(0.0f, position.x - (bounds.maxX - wallMargin));
+        force.y += std::max(0.0f, bounds.minY + wallMargin - position.y) - std::max(0.0f, position.y - (bounds.maxY - wallMargin));
+        force.z += std::max(0.0f, bounds.minZ + wallMargin - position.z) - std::max(0.0f, position.z - (bounds.maxZ - wallMargin));
+        return force / wallMargin;
+    }
+
+    // Isti raspored transformacija kao Fish::getModelMatrix: skretanje po y, nagib po z, pa osnovna rotacija modela
+    static glm::mat4 modelMatrix(const glm::vec3& position, const glm::vec3& velocity, const Species& entry)
+    {
+        float speed = glm::length(velocity);
+        glm::vec3 heading = speed > 0.0001f ? velocity / speed : glm::vec3(1.0f, 0.0f, 0.0f);
+
+        float yawAngle = atan2(-heading.z, heading.x);
+        float pitchAngle = heading.y * glm::radians(25.0f);
+
+        glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), position);
+        modelMat = glm::rotate(modelMat, yawAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+        modelMat = glm::rotate(modelMat, pitchAngle, glm::vec3(0.0f, 0.0f, 1.0f));
+        return modelMat * entry.localTransform;
+    }
 };
 
+// Hrana je bazen ogranicene velicine bez mrtvih cestica: pojedena cestica se odmah uklanja tako sto na
+// njeno mesto dodje poslednja (swap-and-pop), a kad je bazen pun, nova porcija preuzima mesto najstarije.
+// Memorija i posao po frejmu zato zavise samo od kapaciteta, a ne od toga koliko puta je hrana bacena.
 class FoodSystem {
 public:
-    std::vector<FoodParticle> foods;
-    Mesh* foodMesh;
+    std::vector<FoodParticle> foods; // samo zive cestice
+    std::vector<Mesh>* foodLods;
+    InstancedSpheres foodBatch;
     AquariumBounds bounds;
     float sandY;
     float targetY;
+    size_t capacity;
+
+    // Statistika za benchmark
+    size_t spawned = 0;   // ukupno bacenih cestica
+    size_t eaten = 0;     // pojedenih, njihova mesta se ponovo koriste
+    size_t recycled = 0;  // najstarijih cestica zamenjenih novim jer je bazen bio pun
 
-    FoodSystem(Mesh* mesh, AquariumBounds bounds, float sandY)
-        : foodMesh(mesh), bounds(bounds), sandY(sandY), targetY(0.0f) {}
+    size_t eatTests = 0;  // provera riba-cestica posle broadphase-a
+
+    FoodSystem(std::vector<Mesh>* lods, AquariumBounds bounds, float sandY, size_t capacity = 256)
+        : foodLods(lods), foodBatch(lods), bounds(bounds), sandY(sandY), targetY(0.0f), capacity(capacity),
+          grid(glm::vec3(bounds.minX, bounds.minY, bounds.minZ), glm::vec3(bounds.maxX, bounds.maxY, bounds.maxZ), 0.5f)
+    {
+        foods.reserve(capacity);
+    }
+
+    size_t liveCount() const
+    {
+        return foods.size();
+    }
 
     void spawnFood(Aquarium& aquarium, int count = 5)
     {
@@ -1165,47 +1801,63 @@ public:
 
             FoodParticle f;
             f.position = glm::vec3(x, bounds.maxY + 0.5f, z);
+            f.previousPosition = f.position;
             f.speed = 0.8f + ((rand() % 100) / 100.0f) * 0.5f;
             f.radius = 0.05f + ((rand() % 100) / 100.0f) * 0.05f;
-            f.alive = true;
             f.targetY = targetY + f.radius;
+            maxFoodRadius = std::max(maxFoodRadius, f.radius);
+            f.sequence = spawned++;
 
-            foods.push_back(f);
+            if (foods.size() < capacity) {
+                foods.push_back(f);
+            }
+            else if (capacity > 0) {
+                foods[oldestIndex()] = f;
+                recycled++;
+            }
         }
     }
 
     bool checkFishEatsFood(const Fish& fish, const FoodParticle& food)
     {
-        glm::vec3 size = fish.model->maxBounds - fish.model->minBounds;
-        float baseRadius = glm::length(size) * 0.5f;
-        float fishRadius = baseRadius * fish.scale;
-
-        float foodRadius = food.radius;
-        float dist = glm::length(fish.position - food.position);
-
-        return dist <= (fishRadius + foodRadius);
+        float reach = fish.radius() + food.radius;
+        glm::vec3 offset = fish.position - food.position;
+        return glm::dot(offset, offset) <= reach * reach;
     }
 
-    void handleEating(Fish& fish)
+    // Cestice se jednom po koraku rasporede u prostornu mrezu, pa svaka riba proverava samo cestice iz
+    // celija koje dodiruje njena sfera. Riba pojede sve cestice koje dodiruje; cestice se uklanjaju tek
+    // na kraju, jer uklanjanje menja indekse u mrezi.
+    void handleEating(const std::vector<Fish*>& fishes)
     {
-        for (auto& food : foods)
-        {
-            if (!food.alive) continue;
+        if (foods.empty()) return;
 
-            if (checkFishEatsFood(fish, food))
-            {
-                food.alive = false;
+        grid.build(foods, [](const FoodParticle& food) { return food.position; });
+        eatenFlags.assign(foods.size(), 0);
+        eatenIndices.clear();
 
-                fish.scale *= 1.01f;
-            }
+        for (Fish* fish : fishes) {
+            grid.query(fish->position, fish->radius() + maxFoodRadius, [&](size_t index) {
+                eatTests++;
+                if (eatenFlags[index] || !checkFishEatsFood(*fish, foods[index])) return;
+
+                eatenFlags[index] = 1;
+                eatenIndices.push_back(index);
+                fish->scale *= 1.01f;
+            });
         }
+
+        // od najveceg indeksa, da swap-and-pop ne pomeri cestice koje tek treba ukloniti
+        std::sort(eatenIndices.begin(), eatenIndices.end(), std::greater<size_t>());
+        for (size_t index : eatenIndices)
+            removeAt(index);
+        eaten += eatenIndices.size();
     }
 
     void update(float deltaTime)
     {
         for (auto& f : foods) {
-            if (!f.alive) continue;
-
+            f.previousPosition = f.position;
             f.position.y -= f.speed * deltaTime;
 
             if (f.position.y < f.targetY) {
@@ -1214,20 +1866,38 @@ public:
         }
     }
 
-    void draw(Shader& shader)
+    // Sve zive cestice se prepisuju u instance bafer i crtaju jednim pozivom,
+    // pa broj bacenih porcija hrane ne utice na broj draw poziva
+    void submit(RenderQueue& queue, const LodSelector& lod, Shader& instancedShader, float alpha)
     {
-        shader.use();
-        shader.setVec4("uColor", glm::vec4(0.7f, 0.5f, 0.2f, 1.0f)); 
+        foodBatch.clear();
+        for (const auto& f : foods) {
+            foodBatch.add(glm::mix(f.previousPosition, f.position, alpha), f.radius, 1.0f);
+        }
 
-        for (auto& f : foods) {
-            if (!f.alive) continue;
+        foodBatch.submit(queue, lod, instancedShader, glm::vec4(0.7f, 0.5f, 0.2f, 1.0f), PASS_OPAQUE);
+    }
 
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, f.position);
-            model = glm::scale(model, glm::vec3(f.radius));
-            shader.setMat4("model", model);
-            foodMesh->Draw(shader);
+private:
+    SpatialHash grid;
+    float maxFoodRadius = 0.0f; // najveci poluprecnik ikad bacene cestice, prosiruje upit u mrezu
+    std::vector<char> eatenFlags;
+    std::vector<size_t> eatenIndices;
+
+    void removeAt(size_t i)
+    {
+        foods[i] = foods.back();
+        foods.pop_back();
+    }
+
+    size_t oldestIndex() const
+    {
+        size_t oldest = 0;
+        for (size_t i = 1; i < foods.size(); i++) {
+            if (foods[i].sequence < foods[oldest].sequence)
+                oldest = i;
         }
+        return oldest;
     }
 };
 
@@ -1246,7 +1916,7 @@ int endProgram(std::string message) {
     return -1;
 }
 
-void processInput(Fish& goldfish, Fish& clownfish, FoodSystem& foodSystem, Aquarium& aquarium, Chest& chest)
+void processInput(Fish& goldfish, Fish& clownfish, BubbleSystem& bubbles, FoodSystem& foodSystem, Aquarium& aquarium, Chest& chest)
 {
     goldfishInput = glm::vec3(0.0f);
     clownfishInput = glm::vec3(0.0f);
@@ -1289,7 +1959,7 @@ void processInput(Fish& goldfish, Fish& clownfish, FoodSystem& foodSystem, Aquar
 
     if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
         if (!isZPressed) {
-            goldfish.emitBubbles();
+            goldfish.emitBubbles(bubbles);
             isZPressed = true;
         }
     }
@@ -1299,7 +1969,7 @@ void processInput(Fish& goldfish, Fish& clownfish, FoodSystem& foodSystem, Aquar
 
     if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
         if (!isXPressed) {
-            clownfish.emitBubbles();
+            clownfish.emitBubbles(bubbles);
             isXPressed = true;
         }
     }
@@ -1328,43 +1998,146 @@ void processInput(Fish& goldfish, Fish& clownfish, FoodSystem& foodSystem, Aquar
     }
 }
 
-void applyGlobalGLState()
+// Skriptovan unos za --bench rezim: ribe plivaju u krug, povremeno ispustaju mehurice,
+// hrana se baca i kovceg se otvara/zatvara, pa svako merenje vrti istu scenu.
+void benchInput(int frame, Fish& goldfish, Fish& clownfish, BubbleSystem& bubbles, FoodSystem& foodSystem, Aquarium& aquarium, Chest& chest)
 {
-    if (depthTestEnabled) glEnable(GL_DEPTH_TEST);
-    else glDisable(GL_DEPTH_TEST);
+    float t = frame / (float)targetFPS;
 
-    if (cullFaceEnabled) glEnable(GL_CULL_FACE);
-    else glDisable(GL_CULL_FACE);
+    goldfishInput = glm::vec3(cos(t), 0.3f * sin(t * 0.5f), sin(t));
+    clownfishInput = glm::vec3(-sin(t * 0.8f), 0.3f * cos(t * 0.4f), cos(t * 0.8f));
 
-    glCullFace(GL_BACK);
+    if (frame % 10 == 0) {
+        goldfish.emitBubbles(bubbles);
+        clownfish.emitBubbles(bubbles);
+    }
+    if (frame % 60 == 0) {
+        foodSystem.spawnFood(aquarium, 8);
+    }
+    if (frame % 240 == 0) {
+        chest.toggle();
+    }
 }
 
-int main()
+// --bench-geometry: meri generatore geometrije bez GL konteksta, jer MeshData nastaje samo na CPU
+int benchGeometry(const BenchOptions& bench)
 {
+    struct Generator {
+        const char* name;
+        std::function<MeshData()> build;
+    };
+
+    std::vector<Generator> generators = {
+        { "cube", [] { return buildCubeMeshData(glm::vec3(tankWidth, tankHeight, wallThickness)); } },
+        { "sand", [] { return buildSandMeshData(sandRows, sandCols, sandWidth, sandDepth, sandHeight); } },
+        { "cylinder", [] { return buildCylinderMeshData(2.5f, 0.04f, 12); } },
+        { "sphere", [] { return buildSphereMeshData(1.0f, 12, 8); } },
+        { "coin", [] { return buildCoinMeshData(0.15f, 0.03f, 32); } },
+        { "gem", [] { return buildGemMeshData(0.18f); } }
+    };
+
+    std::ofstream file;
+    if (!bench.outputPath.empty()) file.open(bench.outputPath);
+    std::ostream& out = bench.outputPath.empty() ? std::cout : file;
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    for (size_t g = 0; g < generators.size(); g++) {
+        FrameStats stats;
+        stats.reserve(bench.frames);
+        size_t vertexCount = 0, indexCount = 0;
+
+        for (int i = 0; i < bench.frames; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            MeshData data = generators[g].build();
+            stats.addFrame(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+
+            vertexCount = data.vertices.size();
+            indexCount = data.indices.size();
+        }
+
+        out << "  \"" << generators[g].name << "\": { "
+            << "\"iterations\": " << stats.frameCount() << ", "
+            << "\"vertices\": " << vertexCount << ", "
+            << "\"indices\": " << indexCount << ", "
+            << "\"p50_us\": " << stats.percentile(50.0) * 1e6 << ", "
+            << "\"p95_us\": " << stats.percentile(95.0) * 1e6 << ", "
+            << "\"p99_us\": " << stats.percentile(99.0) * 1e6 << " }"
+            << (g + 1 < generators.size() ? ",\n" : "\n");
+    }
+    out << "}" << std::endl;
+    return 0;
+}
+
+void applyGlobalGLState()
+{
+    // GLState propusta samo stvarne promene, pa ovo ne kosta nista dok se prekidaci ne promene
+    GLState& state = GLState::instance();
+    state.setEnabled(GL_DEPTH_TEST, depthTestEnabled);
+    state.setEnabled(GL_CULL_FACE, cullFaceEnabled);
+    state.cullFace(GL_BACK);
+}
+
+int runScene(const BenchOptions& bench);
+
+int main(int argc, char** argv)
+{
+    BenchOptions bench = parseBenchOptions(argc, argv);
+    if (bench.geometryOnly) return benchGeometry(bench);
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    getMonitorResolution();
-    window = glfwCreateWindow(screenWidth, screenHeight, "Akvarijum", glfwGetPrimaryMonitor(), NULL);
+    if (bench.enabled) {
+        // Bez monitora: skriven prozor fiksne velicine sluzi samo kao offscreen kontekst
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        screenWidth = bench.width;
+        screenHeight = bench.height;
+        aspect = (float)screenWidth / screenHeight;
+        window = glfwCreateWindow(screenWidth, screenHeight, "Akvarijum (bench)", NULL, NULL);
+        srand(1234);
+    }
+    else {
+        getMonitorResolution();
+        window = glfwCreateWindow(screenWidth, screenHeight, "Akvarijum", glfwGetPrimaryMonitor(), NULL);
+    }
     if (window == NULL) return endProgram("Prozor nije uspeo da se kreira.");
     glfwMakeContextCurrent(window);
 
     if (glewInit() != GLEW_OK) return endProgram("GLEW nije uspeo da se inicijalizuje.");
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Sve GPU mreze, teksture i sejderi zive unutar runScene, pa se oslobadjaju dok kontekst jos postoji
+    int result = runScene(bench);
+
+    glfwTerminate();
+    return result;
+}
+
+// Pravi scenu i vrti glavnu petlju; kontekst mora biti aktivan
+int runScene(const BenchOptions& bench)
+{
+    // Posle uploada mrezama ne trebaju CPU kopije verteksa i indeksa
+    Mesh::setCpuDataEviction(true);
+
+    GLState& glState = GLState::instance();
+    glState.setEnabled(GL_BLEND, true);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glViewport(0, 0, screenWidth, screenHeight);
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-    glCullFace(GL_BACK);
+    glState.setEnabled(GL_DEPTH_TEST, true);
+    glState.depthMask(true);
+    glState.cullFace(GL_BACK);
     glFrontFace(GL_CCW);
-    glEnable(GL_CULL_FACE);
+    glState.setEnabled(GL_CULL_FACE, true);
 
     glfwSwapInterval(0);
 
+    // Assimp ucitavanje modela ide na pozadinskim nitima (samo CPU), dok glavna nit kompajlira sejdere i pravi scenu
+    auto goldfishLoad = std::async(std::launch::async, [] { return Model("res/goldfish.obj", false, false); });
+    auto clownfishLoad = std::async(std::launch::async, [] { return Model("res/clownfish.obj", false, false); });
+
     glm::vec3 lightPos(6.0f, 10.0f, 6.0f);
     glm::vec3 cameraPos(0.0f, 7.0f, 9.0f);
     projection = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 100.0f);
@@ -1374,25 +2147,64 @@ int main()
         glm::vec3(0.0f, 1.0f, 0.0f)    
     );
 
-    Shader basicShader("basic.vert", "basic.frag");
-    Shader textureShader("texture.vert", "texture.frag");
-    Shader fishShader("fish.vert", "fish.frag");
+    // basic i texture sejderi postoje u dve varijante: sa i bez tackastih svetala (#define POINT_LIGHTS)
+    auto bindLightBuffers = [](Shader& shader) {
+        shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+        shader.use();
+        shader.setInt("uLightData", LIGHT_DATA_UNIT);
+        shader.setInt("uLightClusters", LIGHT_CLUSTERS_UNIT);
+        shader.setInt("uLightIndices", LIGHT_INDICES_UNIT);
+    };
+    ShaderVariants basicVariants("basic.vert", "basic.frag", { "POINT_LIGHTS" }, bindLightBuffers);
+    ShaderVariants textureVariants("texture.vert", "texture.frag", { "POINT_LIGHTS" }, [&](Shader& shader) {
+        bindLightBuffers(shader);
+        shader.setInt("uTex", 0);
+    });
+    // Obe varijante se prevode odmah, da prvo otvaranje kovcega ne zakoci frejm
+    for (unsigned int features : { 0u, POINT_LIGHTS }) {
+        basicVariants.get(features);
+        textureVariants.get(features);
+    }
+    // Igraci se crtaju obicnom varijantom, a jato instanciranom (matrica modela po instanci)
+    ShaderVariants fishVariants("fish.vert", "fish.frag", { "INSTANCED" }, [](Shader& shader) {
+        shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+        shader.use();
+        shader.setInt("uDiffMap", 0);
+    });
+    Shader& fishShader = fishVariants.get(0);
+    Shader& schoolShader = fishVariants.get(FISH_INSTANCED);
     Shader overlayShader("overlay.vert", "overlay.frag");
+    Shader instancedShader("instanced.vert", "instanced.frag");
+    Shader algaeShader("algae.vert", "basic.frag");
+    Shader compositeShader("oit_composite.vert", "oit_composite.frag");
 
     unsigned int sandTex = loadTexture("sand.jpg");
 
     Aquarium aquarium;
 
-    Model goldfishModel("res/goldfish.obj");
+    Model goldfishModel = goldfishLoad.get();
+    goldfishModel.upload();
     Fish goldfish(&goldfishModel, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(-90.0f, 0.0f, 0.0f), 3.0f, 0.1f);
 
-    Model clownfishModel("res/clownfish.obj");
+    Model clownfishModel = clownfishLoad.get();
+    clownfishModel.upload();
     Fish clownfish(&clownfishModel, glm::vec3(3.0f, 2.0f, 0.0f), glm::vec3(0.0f, -90.0f, 0.0f), 3.0f, 0.5f);
 
-    Mesh bubbleMesh = createSphereMesh(1.0f, 12, 8);
-    Mesh foodmesh = createSphereMesh(1.0f, 10, 6);
+    // AI jato deli modele sa igracima; igraci su njegovi clanovi, pa ih ostale ribe zaobilaze
+    FishSchool school(aquarium.getBounds());
+    size_t goldfishSpecies = school.addSpecies(&goldfishModel, glm::vec3(-90.0f, 0.0f, 0.0f), 0.05f);
+    size_t clownfishSpecies = school.addSpecies(&clownfishModel, glm::vec3(0.0f, -90.0f, 0.0f), 0.25f);
+    school.addPlayer(&goldfish);
+    school.addPlayer(&clownfish);
+    school.spawn(goldfishSpecies, bench.schoolSize / 2);
+    school.spawn(clownfishSpecies, bench.schoolSize - bench.schoolSize / 2);
 
-    FoodSystem foodSystem(&foodmesh, aquarium.bounds, sandHeight);
+    std::vector<Mesh> bubbleLods = createSphereLodChain(1.0f, 12, 8);
+    InstancedSpheres bubbleBatch(&bubbleLods);
+    BubbleSystem bubbles;
+    std::vector<Mesh> foodLods = createSphereLodChain(1.0f, 10, 6);
+
+    FoodSystem foodSystem(&foodLods, aquarium.bounds, sandHeight);
 
     Chest chest("wood.png", "wood.png", glm::vec3(-3.0f, 0.8f, 2.0f));
 
@@ -1400,71 +2212,178 @@ int main()
 
     glClearColor(0.12f, 0.5f, 0.88f, 1.0f);
 
-    basicShader.use();
-    basicShader.setMat4("projection", projection);
-    basicShader.setMat4("view", view);
-    basicShader.setVec3("uLightPos", lightPos);
-    basicShader.setVec3("uViewPos", cameraPos);       
-    basicShader.setVec3("uLightColor", glm::vec3(1.0f)); 
-
-    textureShader.use();
-    textureShader.setMat4("projection", projection);
-    textureShader.setMat4("view", view);
-    textureShader.setVec3("uLightPos", lightPos);
-    textureShader.setVec3("uViewPos", cameraPos);
-    textureShader.setVec3("uLightColor", glm::vec3(1.0f));
-    textureShader.setInt("uTex", 0);
-
-    fishShader.use();
-    fishShader.setMat4("projection", projection);
-    fishShader.setMat4("view", view);
-    fishShader.setVec3("uLightPos", lightPos);
-    fishShader.setVec3("uViewPos", cameraPos);
-    fishShader.setVec3("uLightColor", glm::vec3(1.0f));
-    fishShader.setInt("uDiffMap", 0); 
+    // Kamera i svetla idu u zajednicki uniform blok koji citaju svi sejderi
+    instancedShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    algaeShader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+
+    FrameUniformBuffer frameUniforms;
+    frameUniforms.create();
+
+    ClusteredLights clusteredLights;
+    clusteredLights.create();
+    std::vector<PointLight> pointLights;
+
+    FrameData frameData = {};
+    frameData.lightPos = lightPos;
+    frameData.lightColor = glm::vec3(1.0f);
+
+    compositeShader.use();
+    compositeShader.setInt("uAccum", 0);
+    compositeShader.setInt("uWeight", 1);
+
+    // Providni objekti (staklo, mehurici) idu kroz weighted blended OIT, pa ih ne treba sortirati po dubini
+    TransparencyPass transparency;
+    transparency.create(screenWidth, screenHeight);
+
+    RenderQueue renderQueue;
+    renderQueue.orderIndependentTransparency = true;
+
+    FrameStats frameStats;
+    frameStats.reserve(bench.frames);
+    int frame = 0;
+
+    FixedTimestep simulation(1.0 / 120.0);
+    JobSystem jobs(bench.threads);
+    std::vector<Fish*> players = { &goldfish, &clownfish };
 
     auto previous = std::chrono::high_resolution_clock::now();
 
     while (!glfwWindowShouldClose(window))
     {
+        if (bench.enabled && frame >= bench.warmupFrames + bench.frames) break;
+        if (bench.enabled && frame == bench.warmupFrames) glState.resetCounters();
+
         auto now = std::chrono::high_resolution_clock::now();
-        float deltaTime = std::chrono::duration<float>(now - previous).count();
+        double elapsed = std::chrono::duration<double>(now - previous).count();
         previous = now;
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // U bench rezimu i vreme frejma je fiksno, pa svako merenje simulira iste korake
+        if (bench.enabled) elapsed = 1.0 / targetFPS;
+
+        transparency.beginOpaque();
 
-        processInput(goldfish, clownfish, foodSystem, aquarium, chest);
+        if (bench.enabled)
+            benchInput(frame, goldfish, clownfish, bubbles, foodSystem, aquarium, chest);
+        else
+            processInput(goldfish, clownfish, bubbles, foodSystem, aquarium, chest);
 
         applyGlobalGLState();
 
-        aquarium.Draw(basicShader, textureShader, sandTex, deltaTime);
+        // Jedan upload po frejmu, bez obzira na broj sejdera
+        frameData.projection = projection;
+        frameData.view = view;
+        frameData.viewPos = cameraPos;
+
+        // Tackasta svetla se rasporede po klasterima pre slanja bloka, jer blok nosi i parametre klastera
+        pointLights.clear();
+        chest.collectLights(pointLights);
+        clusteredLights.update(pointLights, view, projection, screenWidth, screenHeight, frameData);
+        clusteredLights.bind();
+        frameUniforms.update(frameData);
+
+        // Simulacija ide fiksnim korakom nezavisno od brzine frejmova; crta se stanje interpolirano
+        // izmedju poslednja dva koraka
+        int steps = simulation.advance(elapsed);
+        // Svaki korak je graf poslova: nezavisni sistemi se pomeraju paralelno, kovceg tek kad se ribe sudare
+        // sa njim, a jato i jedenje hrane kad su igraci na novom mestu
+        for (int step = 0; step < steps; step++) {
+            float deltaTime = (float)simulation.step;
+
+            JobHandle goldfishMoved = jobs.schedule([&]() { goldfish.update(deltaTime, goldfishInput, aquarium.getBounds(), chest); });
+            JobHandle clownfishMoved = jobs.schedule([&]() { clownfish.update(deltaTime, clownfishInput, aquarium.getBounds(), chest); });
+            JobHandle bubblesMoved = jobs.schedule([&]() { bubbles.update(deltaTime, aquarium.getBounds().maxY); });
+            JobHandle foodMoved = jobs.schedule([&]() { foodSystem.update(deltaTime); });
+
+            JobHandle chestMoved = jobs.schedule([&]() { chest.update(deltaTime); }, { goldfishMoved, clownfishMoved });
+            JobHandle schoolMoved = school.scheduleUpdate(jobs, deltaTime, { goldfishMoved, clownfishMoved });
+            JobHandle eaten = jobs.schedule([&]() { foodSystem.handleEating(players); }, { goldfishMoved, clownfishMoved, foodMoved });
+
+            jobs.wait(jobs.schedule([]() {}, { bubblesMoved, chestMoved, schoolMoved, eaten }));
+        }
+        float alpha = simulation.alpha();
+
+        // Sistemi samo prijavljuju pozive; red ih sortira po prolazu, programu i teksturi i tek onda crta
+        renderQueue.begin(cameraPos, projection * view, cullFaceEnabled, depthTestEnabled);
+
+        LodSelector lod(cameraPos, projection, (float)screenHeight);
 
-        goldfish.update(deltaTime, goldfishInput, aquarium.getBounds(), chest);
-        clownfish.update(deltaTime, clownfishInput, aquarium.getBounds(), chest); 
-        foodSystem.update(deltaTime);
-        chest.update(deltaTime);
+        aquarium.submit(renderQueue, lod, basicVariants, textureVariants, clusteredLights, algaeShader, sandTex, (float)simulation.time());
+        goldfish.submit(renderQueue, fishShader, alpha);
+        clownfish.submit(renderQueue, fishShader, alpha);
+        school.submit(renderQueue, schoolShader, alpha, jobs);
 
-        foodSystem.handleEating(goldfish);
-        foodSystem.handleEating(clownfish);
+        // Svi mehurici svih riba u jednom pozivu
+        bubbleBatch.clear();
+        bubbles.collect(bubbleBatch, alpha);
+        bubbleBatch.submit(renderQueue, lod, instancedShader, glm::vec4(0.9f, 0.95f, 1.0f, 1.0f), PASS_TRANSPARENT);
+        foodSystem.submit(renderQueue, lod, instancedShader, alpha);
+        chest.submit(renderQueue, textureVariants, basicVariants, clusteredLights, alpha);
 
-        goldfish.draw(fishShader);
-        goldfish.drawBubbles(basicShader, bubbleMesh);
-        clownfish.draw(fishShader);
-        clownfish.drawBubbles(basicShader, bubbleMesh);
-        foodSystem.draw(basicShader);
-        chest.draw(textureShader, basicShader);
+        signatureOverlay.submit(renderQueue, overlayShader, screenWidth, screenHeight, 10.0f, 10.0f);
 
-        signatureOverlay.Draw(overlayShader, screenWidth, screenHeight, 10.0f, 10.0f);
+        renderQueue.executePass(PASS_OPAQUE);
+
+        transparency.beginTransparent();
+        renderQueue.executePass(PASS_TRANSPARENT);
+        transparency.composite(compositeShader);
+
+        renderQueue.executePass(PASS_OVERLAY);
 
         glfwSwapBuffers(window); 
         glfwPollEvents(); 
 
+        if (bench.enabled) {
+            // Cekamo GPU da bi vreme frejma obuhvatilo i iscrtavanje, a ne samo slanje komandi
+            glFinish();
+            if (frame >= bench.warmupFrames)
+                frameStats.addFrame(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - now).count());
+            frame++;
+            continue;
+        }
+
         auto frameTime = std::chrono::high_resolution_clock::now() - now;
         if (frameTime < targetFrameDuration) {
             std::this_thread::sleep_for(targetFrameDuration - frameTime);
         }
     }
 
-    glfwTerminate();
+    if (bench.enabled) {
+        frameStats.setCounter("width", screenWidth);
+        frameStats.setCounter("height", screenHeight);
+        frameStats.setCounter("texture_decodes", (double)TextureCache::instance().decodes);
+        frameStats.setCounter("texture_cache_hits", (double)(TextureCache::instance().pathHits + TextureCache::instance().contentHits));
+        frameStats.setCounter("draw_calls", (double)renderQueue.drawCalls);
+        frameStats.setCounter("program_switches", (double)renderQueue.programSwitches);
+        frameStats.setCounter("texture_switches", (double)renderQueue.textureSwitches);
+        frameStats.setCounter("culled_objects", (double)renderQueue.culledObjects);
+        frameStats.setCounter("triangles", (double)renderQueue.triangles);
+        frameStats.setCounter("shader_cache_hits", (double)ProgramBinaryCache::instance().hits);
+        frameStats.setCounter("shader_cache_misses", (double)ProgramBinaryCache::instance().misses);
+        frameStats.setCounter("simulation_steps", (double)simulation.steps);
+        frameStats.setCounter("dropped_simulation_steps", (double)simulation.droppedSteps);
+        frameStats.setCounter("dropped_bubbles", (double)bubbles.dropped);
+        frameStats.setCounter("live_food", (double)foodSystem.liveCount());
+        frameStats.setCounter("eaten_food", (double)foodSystem.eaten);
+        frameStats.setCounter("recycled_food", (double)foodSystem.recycled);
+        frameStats.setCounter("eat_tests", (double)foodSystem.eatTests);
+        frameStats.setCounter("school_fish", (double)school.size());
+        frameStats.setCounter("neighbour_tests", (double)school.neighbourTests);
+        frameStats.setCounter("worker_threads", (double)jobs.workerCount());
+        frameStats.setCounter("jobs_run", (double)jobs.jobsRun);
+        frameStats.setCounter("job_steals", (double)jobs.steals);
+        frameStats.setCounter("point_lights", (double)clusteredLights.lightCount());
+        frameStats.setCounter("light_cluster_indices", (double)clusteredLights.assignedIndices);
+        frameStats.setCounter("gl_state_calls_per_frame", (double)glState.issued / frameStats.frameCount());
+        frameStats.setCounter("gl_state_skipped_per_frame", (double)glState.skipped / frameStats.frameCount());
+
+        if (bench.outputPath.empty()) {
+            frameStats.writeJson(std::cout);
+        }
+        else {
+            std::ofstream out(bench.outputPath);
+            frameStats.writeJson(out);
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -8,9 +8,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "GLState.h"
 #include "Shader.h"
+#include "TextureCache.h"
 
+#include <cmath>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -29,73 +33,244 @@ struct Texture {
     string path;
 };
 
+// CPU side mesh data. Building it makes no GL calls, so generators and model loading can run on any thread;
+// the GPU resident Mesh is created from it later on the thread that owns the GL context.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
+
+    MeshData() : minBounds(0.0f), maxBounds(0.0f) {}
+
+    MeshData(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures = vector<Texture>())
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
+    {
+        computeBounds();
+    }
+
+    // recomputes the axis aligned bounding box of the vertex positions
+    void computeBounds()
+    {
+        if (vertices.empty())
+        {
+            minBounds = maxBounds = glm::vec3(0.0f);
+            return;
+        }
+
+        minBounds = maxBounds = vertices[0].Position;
+        for (const Vertex& v : vertices)
+        {
+            minBounds = glm::min(minBounds, v.Position);
+            maxBounds = glm::max(maxBounds, v.Position);
+        }
+    }
+};
+
+// GPU resident mesh. It owns its VAO/VBO/EBO and one TextureCache reference per texture, so it can be moved but
+// not copied, and it frees everything on destruction (which has to happen while the GL context is alive).
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data (empty after upload when CPU data eviction is on, see setCpuDataEviction)
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    unsigned int VAO = 0;
+    GLsizei indexCount = 0;
+
+    // local space bounding box
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        : Mesh(MeshData(std::move(vertices), std::move(indices), std::move(textures)))
+    {
+    }
+
+    // uploads CPU mesh data to the GPU, must be called on the thread that owns the GL context.
+    // keepCpuData keeps vertices/indices even when eviction is on, for meshes that are queried on the CPU.
+    explicit Mesh(MeshData data, bool keepCpuData = false)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(data.vertices);
+        this->indices = std::move(data.indices);
+        this->textures = std::move(data.textures);
+        this->minBounds = data.minBounds;
+        this->maxBounds = data.maxBounds;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
+
+        if (cpuDataEviction() && !keepCpuData)
+        {
+            vector<Vertex>().swap(this->vertices);
+            vector<unsigned int>().swap(this->indices);
+        }
+    }
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh&& other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    Mesh& operator=(Mesh&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~Mesh()
+    {
+        release();
+    }
+
+    // opt-in: when enabled, meshes created afterwards drop their CPU vertex/index arrays once they are on the GPU
+    static void setCpuDataEviction(bool enabled)
+    {
+        cpuDataEvictionFlag() = enabled;
+    }
+    static bool cpuDataEviction()
+    {
+        return cpuDataEvictionFlag();
     }
 
     // render the mesh
     void Draw(Shader& shader)
     {
-        // bind appropriate textures
+        bindTextures(shader);
+
+        // draw mesh. The VAO and textures stay bound, GLState skips rebinding them for the next draw of this mesh.
+        GLState::instance().bindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    }
+
+    // render instanceCount copies of the mesh in one draw call. The per-instance attributes have to be
+    // attached to the VAO first (see InstanceBuffer::attach): this mesh's own one, or vertexArray when it
+    // is not 0 (see createSharedVAO).
+    void DrawInstanced(Shader& shader, GLsizei instanceCount, unsigned int vertexArray = 0)
+    {
+        if (instanceCount <= 0)
+            return;
+
+        bindTextures(shader);
+
+        GLState::instance().bindVertexArray(vertexArray != 0 ? vertexArray : VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+    }
+
+    // a new VAO over this mesh's vertex and index buffers with the same vertex attributes. Extra attributes
+    // (per-instance data) can be attached to it without changing what the regular draws of the mesh see.
+    // The caller owns the VAO and has to delete it before the mesh goes away.
+    unsigned int createSharedVAO() const
+    {
+        unsigned int vertexArray = 0;
+        glGenVertexArrays(1, &vertexArray);
+
+        GLState::instance().bindVertexArray(vertexArray);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        setupVertexAttributes();
+        return vertexArray;
+    }
+
+private:
+    // render data 
+    unsigned int VBO = 0, EBO = 0;
+    vector<string> samplerNames; // sampler uniform of each texture, built once instead of on every draw
+
+    static bool& cpuDataEvictionFlag()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+
+    // frees the GL objects and the texture references of this mesh
+    void release()
+    {
+        if (VAO != 0)
+        {
+            GLState::instance().forgetVertexArray(VAO);
+            GLState::instance().forgetBuffer(VBO);
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+        }
+        for (const Texture& texture : textures)
+            TextureCache::instance().release(texture.id);
+
+        VAO = VBO = EBO = 0;
+        indexCount = 0;
+        textures.clear();
+    }
+
+    void moveFrom(Mesh& other)
+    {
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        samplerNames = std::move(other.samplerNames);
+        VAO = other.VAO;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        indexCount = other.indexCount;
+        minBounds = other.minBounds;
+        maxBounds = other.maxBounds;
+
+        other.textures.clear();
+        other.VAO = other.VBO = other.EBO = 0;
+        other.indexCount = 0;
+    }
+
+    // bind appropriate textures
+    void bindTextures(Shader& shader)
+    {
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            // set the sampler to the correct texture unit
+            shader.setInt(samplerNames[i], i);
+            // and bind the texture to that unit
+            GLState::instance().bindTexture(i, textures[i].id);
+        }
+    }
+
+    // builds the sampler uniform name of every texture (the N in uDiffMapN)
+    void setupSamplerNames()
+    {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
+        samplerNames.clear();
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
             string name = textures[i].type;
             if (name == "uDiffMap")
-                number = std::to_string(diffuseNr++);
+                samplerNames.push_back(name + std::to_string(diffuseNr++));
             else
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                samplerNames.push_back(name + std::to_string(specularNr++));
         }
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        setupSamplerNames();
+        indexCount = static_cast<GLsizei>(indices.size());
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::instance().bindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
@@ -104,6 +279,12 @@ private:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
+        setupVertexAttributes();
+    }
+
+    // attribute pointers of the bound VAO into the bound vertex buffer
+    static void setupVertexAttributes()
+    {
         // set the vertex attribute pointers
         // vertex Positions
         glEnableVertexAttribArray(0);
@@ -116,5 +297,62 @@ private:
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
     }
 };
+
+// normal matrix of a model matrix, transpose(inverse(mat3(model))). Rotations with a uniform scale s (every object
+// in the scene except sheared or squashed ones) take the fast path: the inverse transpose of s * R is R / s, so
+// no inverse is needed.
+glm::mat3 computeNormalMatrix(const glm::mat4& model)
+{
+    glm::mat3 m(model);
+
+    float xx = glm::dot(m[0], m[0]);
+    float yy = glm::dot(m[1], m[1]);
+    float zz = glm::dot(m[2], m[2]);
+    float tolerance = 1e-4f * xx;
+
+    bool uniformScale = std::abs(xx - yy) <= tolerance && std::abs(xx - zz) <= tolerance &&
+        std::abs(glm::dot(m[0], m[1])) <= tolerance &&
+        std::abs(glm::dot(m[0], m[2])) <= tolerance &&
+        std::abs(glm::dot(m[1], m[2])) <= tolerance;
+
+    if (uniformScale && xx > 0.0f)
+        return m * (1.0f / xx);
+
+    return glm::transpose(glm::inverse(m));
+}
+
+// appends src to dst with every vertex pre-transformed by transform (used to merge static geometry into one
+// vertex buffer). Textures of src are not merged, the batch is drawn with the textures of dst.
+void appendMeshData(MeshData& dst, const MeshData& src, const glm::mat4& transform)
+{
+    glm::mat3 normalMatrix = computeNormalMatrix(transform);
+    unsigned int baseIndex = static_cast<unsigned int>(dst.vertices.size());
+
+    dst.vertices.reserve(dst.vertices.size() + src.vertices.size());
+    for (const Vertex& v : src.vertices)
+    {
+        Vertex transformed = v;
+        transformed.Position = glm::vec3(transform * glm::vec4(v.Position, 1.0f));
+        transformed.Normal = glm::normalize(normalMatrix * v.Normal);
+        dst.vertices.push_back(transformed);
+    }
+
+    dst.indices.reserve(dst.indices.size() + src.indices.size());
+    for (unsigned int index : src.indices)
+        dst.indices.push_back(baseIndex + index);
+
+    dst.computeBounds();
+}
+
+// batched upload step: turns a set of CPU meshes (e.g. built on worker threads) into GPU meshes in one go
+vector<Mesh> uploadMeshes(vector<MeshData>& batch)
+{
+    vector<Mesh> meshes;
+    meshes.reserve(batch.size());
+    for (MeshData& data : batch)
+        meshes.push_back(Mesh(std::move(data)));
+    batch.clear();
+    return meshes;
+}
 #endif
 
@@ -1,6 +1,5 @@
 #ifndef MODEL_H
 #define MODEL_H
-#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include <GL/glew.h> 
@@ -14,6 +13,7 @@
 
 #include "Mesh.h"
 #include "Shader.h"
+#include "TextureCache.h"
 
 #include <string>
 #include <fstream>
@@ -30,8 +30,8 @@ class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    vector<MeshData> pendingMeshes;   // loaded on the CPU but not yet uploaded to the GPU
     string directory;
     bool gammaCorrection;
 
@@ -39,11 +39,26 @@ public:
     glm::vec3 maxBounds;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    // with uploadNow = false only the CPU side is loaded (no GL calls, safe on any thread) and upload() has to be
+    // called later on the thread that owns the GL context.
+    Model(string const& path, bool gamma = false, bool uploadNow = true) : gammaCorrection(gamma)
     {
         minBounds = glm::vec3(std::numeric_limits<float>::max());
         maxBounds = glm::vec3(std::numeric_limits<float>::lowest());
         loadModel(path);
+        if (uploadNow)
+            upload();
+    }
+
+    // loads the material textures and creates the GPU meshes of everything loaded so far
+    void upload()
+    {
+        for (MeshData& data : pendingMeshes)
+            loadMaterialTextures(data.textures);
+
+        vector<Mesh> uploaded = uploadMeshes(pendingMeshes);
+        for (Mesh& mesh : uploaded)
+            meshes.push_back(std::move(mesh));
     }
 
     // draws the model, and thus all its meshes
@@ -82,7 +97,7 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            pendingMeshes.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
@@ -92,7 +107,7 @@ private:
 
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    MeshData processMesh(aiMesh* mesh, const aiScene* scene)
     {
         // data to fill
         vector<Vertex> vertices;
@@ -153,48 +168,42 @@ private:
         // diffuse: texture_diffuseN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "uDiffMap");
+        vector<Texture> diffuseMaps = collectMaterialTextures(material, aiTextureType_DIFFUSE, "uDiffMap");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "uSpecMap");
+        vector<Texture> specularMaps = collectMaterialTextures(material, aiTextureType_SPECULAR, "uSpecMap");
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, it is uploaded to the GPU in upload()
+        return MeshData(std::move(vertices), std::move(indices), std::move(textures));
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+    // collects the paths of all material textures of a given type. No GL calls are made here, the texture ids
+    // are filled in by loadMaterialTextures() during upload().
+    vector<Texture> collectMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if (!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    // fills in the texture ids of a mesh. Textures already loaded (by this or any other model, or by Main.cpp)
+    // come from the global TextureCache and are not decoded again.
+    void loadMaterialTextures(vector<Texture>& textures)
+    {
+        for (Texture& texture : textures)
+            texture.id = TextureFromFile(texture.path.c_str(), this->directory, gammaCorrection);
+    }
 };
 
 
@@ -204,39 +213,12 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    // models have always been loaded after main() switched stb_image to vertical flipping, so keep it on
+    TextureOptions options;
+    options.flipVertically = true;
+    options.mipmapFiltering = true;
 
-    return textureID;
+    return TextureCache::instance().acquire(filename, options);
 }
 #endif
 
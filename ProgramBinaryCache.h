@@ -0,0 +1,209 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// on-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// An entry is keyed by a hash of the preprocessed vertex and fragment sources (defines and includes
+// already expanded) and of the driver (vendor, renderer, version), so editing a shader or updating the
+// driver simply misses. A binary the driver rejects is deleted and the program is compiled from source.
+class ProgramBinaryCache
+{
+public:
+    std::string directory = "shader_cache";
+    bool enabled = true;
+
+    // statistics, reported by the benchmark
+    size_t hits = 0;     // programs loaded from a binary
+    size_t misses = 0;   // programs compiled from source
+    size_t rejected = 0; // binaries that existed but the driver refused (subset of misses)
+
+    static ProgramBinaryCache& instance()
+    {
+        static ProgramBinaryCache cache;
+        return cache;
+    }
+
+    // linked program for these sources, or 0 when there is no usable binary
+    unsigned int load(const std::string& vertexSource, const std::string& fragmentSource)
+    {
+        if (!available())
+            return 0;
+
+        uint64_t key = makeKey(vertexSource, fragmentSource);
+        std::string path = pathFor(key);
+
+        GLenum format = 0;
+        std::vector<char> binary;
+        if (!readEntry(path, key, format, binary))
+        {
+            misses++;
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            glDeleteProgram(program);
+            std::remove(path.c_str());
+            rejected++;
+            misses++;
+            return 0;
+        }
+
+        hits++;
+        return program;
+    }
+
+    // call before glLinkProgram, so the driver keeps the binary around for store()
+    void prepare(unsigned int program)
+    {
+        if (available())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // writes the binary of a successfully linked program
+    void store(unsigned int program, const std::string& vertexSource, const std::string& fragmentSource)
+    {
+        if (!available())
+            return;
+
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!linked || length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+        binary.resize(length);
+
+        makeDirectory();
+        uint64_t key = makeKey(vertexSource, fragmentSource);
+        std::ofstream file(pathFor(key), std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::SHADER_CACHE::CANNOT_WRITE: " << pathFor(key) << std::endl;
+            return;
+        }
+
+        uint32_t header[2] = { MAGIC, (uint32_t)format };
+        uint32_t size = (uint32_t)binary.size();
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)&key, sizeof(key));
+        file.write((const char*)&size, sizeof(size));
+        file.write(binary.data(), binary.size());
+    }
+
+private:
+    static const uint32_t MAGIC = 0x31425047; // "GPB1"
+
+    bool checked = false;
+    bool supported = false;
+    std::string driver;
+
+    ProgramBinaryCache() {}
+
+    // needs a current context; the driver has to offer at least one binary format
+    bool available()
+    {
+        if (!enabled)
+            return false;
+        if (!checked)
+        {
+            checked = true;
+            GLint formats = 0;
+            if (GLEW_ARB_get_program_binary)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            supported = formats > 0;
+
+            const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+            for (GLenum name : names)
+            {
+                const GLubyte* value = glGetString(name);
+                driver += value ? (const char*)value : "";
+                driver += '\n';
+            }
+        }
+        return supported;
+    }
+
+    // 64-bit FNV-1a over the driver string and both sources
+    uint64_t makeKey(const std::string& vertexSource, const std::string& fragmentSource) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        const std::string* parts[3] = { &driver, &vertexSource, &fragmentSource };
+        for (const std::string* part : parts)
+        {
+            for (unsigned char byte : *part)
+            {
+                hash ^= byte;
+                hash *= 1099511628211ull;
+            }
+            // separator, so moving text from one source to the other changes the key
+            hash ^= 0xFF;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string pathFor(uint64_t key) const
+    {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+        return directory + "/" + name + ".bin";
+    }
+
+    bool readEntry(const std::string& path, uint64_t key, GLenum& format, std::vector<char>& binary) const
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        uint32_t header[2] = { 0, 0 };
+        uint64_t storedKey = 0;
+        uint32_t size = 0;
+        file.read((char*)header, sizeof(header));
+        file.read((char*)&storedKey, sizeof(storedKey));
+        file.read((char*)&size, sizeof(size));
+        if (!file || header[0] != MAGIC || storedKey != key || size == 0)
+            return false;
+
+        binary.resize(size);
+        file.read(binary.data(), size);
+        if (file.gcount() != (std::streamsize)size)
+            return false; // truncated entry
+
+        format = header[1];
+        return true;
+    }
+
+    void makeDirectory() const
+    {
+        // fails harmlessly when the directory already exists
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+};
+#endif
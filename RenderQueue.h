@@ -0,0 +1,292 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "GLState.h"
+#include "Mesh.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// passes are executed in this order; the pass is the most significant part of the sort key
+enum RenderPass {
+    PASS_OPAQUE = 0,
+    PASS_TRANSPARENT = 1,
+    PASS_OVERLAY = 2,
+    PASS_COUNT = 3
+};
+
+// everything needed to issue one draw call. Uniforms that are the same for every draw of a program
+// (uTime, the overlay projection, samplers) are set on the program when the item is submitted, the
+// per-draw ones below are set by the executor.
+struct DrawItem {
+    RenderPass pass = PASS_OPAQUE;
+    Shader* shader = nullptr;
+
+    // geometry: a Mesh (drawn with its own textures) or, when mesh is null, a raw VAO with indexCount indices.
+    // An instanced Mesh draw can set VAO too, to draw through a VAO shared with the mesh (Mesh::createSharedVAO).
+    Mesh* mesh = nullptr;
+    unsigned int VAO = 0;
+    GLsizei indexCount = 0;
+    GLsizei instanceCount = 0; // 0 = regular draw, otherwise glDrawElementsInstanced
+
+    unsigned int texture = 0;  // extra texture bound to unit 0 (sand, overlay)
+
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec4 color = glm::vec4(1.0f);
+    bool hasColor = false;       // sets uColor
+
+    // fixed function state; the global toggles can still switch depth test / culling off for everything
+    bool cullFace = true;
+    bool depthTest = true;
+    bool depthWrite = true;
+
+    // world space bounding sphere: the center is used for depth sorting, the sphere for frustum culling
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = -1.0f; // negative = never culled
+
+    void setBounds(const BoundingSphere& sphere)
+    {
+        center = sphere.center;
+        radius = sphere.radius;
+    }
+};
+
+// collects the draws of a frame and issues them sorted by a 64-bit key:
+//   opaque:      pass | program | texture | VAO | depth (front to back)
+//   transparent: pass | depth (back to front) | program | texture | VAO
+//                or, with order independent transparency, pass | program | texture | VAO like opaque draws
+//   overlay:     pass | submission order
+// so opaque draws are grouped to minimise program and texture switches, while blended draws keep a correct order.
+class RenderQueue
+{
+public:
+    // transparent items are drawn into a TransparencyPass (uOitPass = true, no depth writes), so their
+    // order doesn't matter and they are sorted by state only
+    bool orderIndependentTransparency = false;
+
+    // statistics of the last executed frame
+    size_t drawCalls = 0;
+    size_t programSwitches = 0;
+    size_t textureSwitches = 0;
+    size_t culledObjects = 0; // items and instances rejected by the frustum test
+    size_t triangles = 0;
+
+    // starts a new frame. viewProjection is the camera used for culling, cullFace/depthTest are the global
+    // toggles and maxDepth the far plane of the camera.
+    void begin(const glm::vec3& cameraPos, const glm::mat4& viewProjection, bool cullFace, bool depthTest, float maxDepth = 100.0f)
+    {
+        items.clear();
+        this->cameraPos = cameraPos;
+        frustum.extract(viewProjection);
+        this->cullFace = cullFace;
+        this->depthTest = depthTest;
+        this->maxDepth = maxDepth;
+        sorted = false;
+
+        drawCalls = 0;
+        programSwitches = 0;
+        textureSwitches = 0;
+        culledObjects = 0;
+        triangles = 0;
+        currentProgram = 0;
+        currentTexture = 0;
+    }
+
+    // frustum test for things that are culled before they become an item (whole models, single instances)
+    bool isVisible(const BoundingSphere& sphere)
+    {
+        if (frustum.intersectsSphere(sphere))
+            return true;
+        culledObjects++;
+        return false;
+    }
+
+    // frustum of the current frame, for culling done off the render thread. The caller adds what it
+    // rejected to culledObjects itself, isVisible is not safe to call from several threads.
+    const Frustum& getFrustum() const
+    {
+        return frustum;
+    }
+
+    // items outside the frustum are dropped here and never reach the sort
+    void submit(const DrawItem& item)
+    {
+        if (item.radius >= 0.0f && !isVisible({ item.center, item.radius }))
+            return;
+
+        Entry entry;
+        entry.key = makeKey(item, (uint32_t)items.size());
+        entry.item = item;
+        items.push_back(entry);
+        sorted = false;
+    }
+
+    void sort()
+    {
+        if (sorted) return;
+        std::stable_sort(items.begin(), items.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+        sorted = true;
+    }
+
+    // issues the draws of one pass (sorts first if needed). Passes can be executed separately when
+    // something has to happen in between, e.g. switching render targets.
+    void executePass(RenderPass pass)
+    {
+        sort();
+
+        uint64_t passBits = (uint64_t)pass << PASS_SHIFT;
+        auto first = std::lower_bound(items.begin(), items.end(), passBits,
+            [](const Entry& entry, uint64_t key) { return entry.key < key; });
+
+        for (auto it = first; it != items.end() && (it->key >> PASS_SHIFT) == (uint64_t)pass; ++it)
+            issue(it->item);
+
+        restoreState();
+    }
+
+    // all passes in order: opaque -> transparent -> overlay
+    void execute()
+    {
+        for (int pass = 0; pass < PASS_COUNT; pass++)
+            executePass((RenderPass)pass);
+    }
+
+    size_t size() const
+    {
+        return items.size();
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        DrawItem item;
+    };
+
+    static const int PASS_SHIFT = 62;
+    static const uint64_t DEPTH_MAX = (1ull << 24) - 1;
+
+    std::vector<Entry> items;
+    bool sorted = false;
+
+    glm::vec3 cameraPos = glm::vec3(0.0f);
+    Frustum frustum;
+    float maxDepth = 100.0f;
+    bool cullFace = true;
+    bool depthTest = true;
+
+    // state while executing
+    unsigned int currentProgram = 0;
+    unsigned int currentTexture = 0;
+    UniformHandle modelLoc, colorLoc, oitLoc, normalMatrixLoc;
+
+    static unsigned int textureOf(const DrawItem& item)
+    {
+        if (item.mesh && !item.mesh->textures.empty())
+            return item.mesh->textures[0].id;
+        return item.texture;
+    }
+
+    static unsigned int vaoOf(const DrawItem& item)
+    {
+        return item.VAO != 0 || !item.mesh ? item.VAO : item.mesh->VAO;
+    }
+
+    uint64_t makeKey(const DrawItem& item, uint32_t sequence) const
+    {
+        uint64_t key = (uint64_t)item.pass << PASS_SHIFT;
+        if (item.pass == PASS_OVERLAY)
+            return key | sequence;
+
+        float distance = glm::clamp(glm::length(item.center - cameraPos) / maxDepth, 0.0f, 1.0f);
+        uint64_t depth = (uint64_t)(distance * DEPTH_MAX);
+
+        // GL names are small integers, so a few bits each are enough to group equal ones
+        uint64_t program = item.shader ? (item.shader->ID & 0x3FF) : 0;   // 10 bits
+        uint64_t texture = textureOf(item) & 0xFFF;                       // 12 bits
+        uint64_t vao = vaoOf(item) & 0xFFF;                               // 12 bits
+
+        if (item.pass == PASS_OPAQUE)
+            return key | (program << 48) | (texture << 36) | (vao << 24) | depth;
+
+        if (orderIndependentTransparency)
+            return key | (program << 48) | (texture << 36) | (vao << 24);
+
+        return key | ((DEPTH_MAX - depth) << 34) | (program << 24) | (texture << 12) | vao;
+    }
+
+    void issue(const DrawItem& item)
+    {
+        Shader& shader = *item.shader;
+        if (shader.ID != currentProgram)
+        {
+            shader.use();
+            currentProgram = shader.ID;
+            programSwitches++;
+
+            modelLoc = shader.uniform("model");
+            colorLoc = shader.uniform("uColor");
+            oitLoc = shader.uniform("uOitPass");
+            normalMatrixLoc = shader.uniform("normalMatrix");
+        }
+
+        bool oit = orderIndependentTransparency && item.pass == PASS_TRANSPARENT;
+        applyState(cullFace && item.cullFace, depthTest && item.depthTest, item.depthWrite && !oit);
+
+        unsigned int texture = textureOf(item);
+        if (texture != currentTexture)
+        {
+            currentTexture = texture;
+            textureSwitches++;
+        }
+
+        shader.setMat4(modelLoc, item.model);
+        if (normalMatrixLoc.location != -1)
+            shader.setMat3(normalMatrixLoc, computeNormalMatrix(item.model));
+        if (item.hasColor)
+            shader.setVec4(colorLoc, item.color);
+        shader.setBool(oitLoc, oit);
+
+        if (item.texture != 0)
+            GLState::instance().bindTexture(0, item.texture);
+
+        if (item.mesh)
+        {
+            if (item.instanceCount > 0)
+                item.mesh->DrawInstanced(shader, item.instanceCount, item.VAO);
+            else
+                item.mesh->Draw(shader);
+        }
+        else
+        {
+            GLState::instance().bindVertexArray(item.VAO);
+            if (item.instanceCount > 0)
+                glDrawElementsInstanced(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0, item.instanceCount);
+            else
+                glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0);
+        }
+        drawCalls++;
+        triangles += (size_t)(item.mesh ? item.mesh->indexCount : item.indexCount) / 3 * std::max(item.instanceCount, (GLsizei)1);
+    }
+
+    // redundant changes between consecutive items are filtered out by GLState
+    void applyState(bool cull, bool depth, bool depthWrite)
+    {
+        GLState& state = GLState::instance();
+        state.setEnabled(GL_CULL_FACE, cull);
+        state.setEnabled(GL_DEPTH_TEST, depth);
+        state.depthMask(depthWrite);
+    }
+
+    // back to the global state, so code outside the queue sees what applyGlobalGLState set
+    void restoreState()
+    {
+        applyState(cullFace, depthTest, true);
+    }
+};
+#endif
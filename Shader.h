@@ -4,138 +4,301 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "GLState.h"
+#include "ProgramBinaryCache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// uniform location resolved once (Shader::uniform) and reused for every draw
+struct UniformHandle
+{
+    GLint location = -1;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
-    // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
-    {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
+    // constructor generates the shader on the fly, or loads the linked program from ProgramBinaryCache when these
+    // exact sources were already compiled by this driver. Every define is injected as "#define NAME" right after
+    // the #version line, so one source file can be compiled into several variants (see ShaderVariants).
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>())
+    {
+        // 1. retrieve the vertex/fragment source code from filePath, with #include directives expanded
+        std::string vertexCode = preprocess(vertexPath, defines);
+        std::string fragmentCode = preprocess(fragmentPath, defines);
+
+        // 2. load the program binary, or compile and link the sources and cache the result
+        ProgramBinaryCache& cache = ProgramBinaryCache::instance();
+        ID = cache.load(vertexCode, fragmentCode);
+        if (ID == 0)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            compile(vertexCode, fragmentCode);
+            cache.store(ID, vertexCode, fragmentCode);
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
+        // resolve all uniform locations once so the setters never have to query the driver
+        cacheUniformLocations();
     }
-    // activate the shader
+    // activate the shader (skipped when it is already the current program)
     // ------------------------------------------------------------------------
     void use() const
     {
-        glUseProgram(ID);
+        GLState::instance().useProgram(ID);
+    }
+    // connects a uniform block of this program to a uniform buffer binding point (no-op if the block is not used)
+    // ------------------------------------------------------------------------
+    void bindUniformBlock(const std::string& blockName, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // uniform locations
+    // ------------------------------------------------------------------------
+    GLint getUniformLocation(const std::string& name) const
+    {
+        auto it = uniformLocations.find(name);
+        // unknown or optimized out uniforms map to -1, which glUniform* silently ignores
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+    UniformHandle uniform(const std::string& name) const
+    {
+        UniformHandle handle;
+        handle.location = getUniformLocation(name);
+        return handle;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(uniform(name), value);
+    }
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(uniform(name), value);
+    }
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(handle.location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(uniform(name), value);
+    }
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(handle.location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(uniform(name), value);
+    }
+    void setVec2(UniformHandle handle, const glm::vec2& value) const
+    {
+        glUniform2fv(handle.location, 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(getUniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(uniform(name), value);
+    }
+    void setVec3(UniformHandle handle, const glm::vec3& value) const
+    {
+        glUniform3fv(handle.location, 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec4(uniform(name), value);
+    }
+    void setVec4(UniformHandle handle, const glm::vec4& value) const
+    {
+        glUniform4fv(handle.location, 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getUniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(uniform(name), mat);
+    }
+    void setMat2(UniformHandle handle, const glm::mat2& mat) const
+    {
+        glUniformMatrix2fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniform(name), mat);
+    }
+    void setMat3(UniformHandle handle, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(uniform(name), mat);
+    }
+    void setMat4(UniformHandle handle, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    // queries every active uniform of the linked program once and stores its location by name.
+    // arrays are stored both as "name" and as "name[i]" for every element.
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string buffer(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, &buffer[0]);
+            std::string name(buffer.c_str(), length);
+
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue; // members of uniform blocks have no location
+
+            size_t bracket = name.find('[');
+            if (bracket == std::string::npos)
+            {
+                uniformLocations[name] = location;
+                continue;
+            }
+
+            std::string baseName = name.substr(0, bracket);
+            uniformLocations[baseName] = location;
+            for (GLint element = 0; element < size; element++)
+            {
+                std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+            }
+        }
+    }
+
+    // compiles and links the preprocessed sources into ID
+    // ------------------------------------------------------------------------
+    void compile(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+        // shader Program
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        ProgramBinaryCache::instance().prepare(ID);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessary
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+    }
+
+    // reads a shader file and expands #include "file" (resolved relative to the including file). Every file is
+    // included only once, so shared files can include each other freely.
+    // ------------------------------------------------------------------------
+    static std::string preprocess(const std::string& path, const std::vector<std::string>& defines)
+    {
+        std::set<std::string> included;
+        std::string source = expandIncludes(path, included);
+
+        if (defines.empty())
+            return source;
+
+        // defines have to come after #version, which must be the first statement of the source
+        std::string injected;
+        for (const std::string& define : defines)
+            injected += "#define " + define + "\n";
+
+        size_t version = source.find("#version");
+        size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+        insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+        return source.insert(insertAt, injected);
+    }
+
+    static std::string expandIncludes(const std::string& path, std::set<std::string>& included)
+    {
+        if (!included.insert(path).second)
+            return "";
+
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+            return "";
+        }
+
+        size_t slash = path.find_last_of("/\\");
+        std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+        std::stringstream result;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+            {
+                size_t open = line.find('"', start);
+                size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close != std::string::npos)
+                {
+                    result << expandIncludes(directory + line.substr(open + 1, close - open - 1), included);
+                    continue;
+                }
+                std::cout << "ERROR::SHADER::BAD_INCLUDE in " << path << ": " << line << std::endl;
+                continue;
+            }
+            result << line << '\n';
+        }
+        return result.str();
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
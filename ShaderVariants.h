@@ -0,0 +1,59 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "Shader.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// compile-time permutations of one vertex/fragment pair. Bit i of a feature mask turns on featureDefines[i]
+// (#define NAME), so features cost nothing at runtime: a program without a feature has no code for it at all.
+// Variants are compiled the first time they are requested and cached by their feature mask.
+class ShaderVariants
+{
+public:
+    ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath,
+        const std::vector<std::string>& featureDefines, std::function<void(Shader&)> configure = nullptr)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), featureDefines(featureDefines), configure(configure)
+    {
+    }
+
+    // the program for a feature mask; configure (uniform block bindings, samplers) runs once per new variant
+    Shader& get(unsigned int features)
+    {
+        auto it = variants.find(features);
+        if (it != variants.end())
+            return *it->second;
+
+        std::vector<std::string> defines;
+        for (size_t bit = 0; bit < featureDefines.size(); bit++)
+        {
+            if (features & (1u << bit))
+                defines.push_back(featureDefines[bit]);
+        }
+
+        std::unique_ptr<Shader> shader(new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines));
+        if (configure)
+            configure(*shader);
+
+        Shader& result = *shader;
+        variants[features] = std::move(shader);
+        return result;
+    }
+
+    size_t compiledCount() const
+    {
+        return variants.size();
+    }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> featureDefines;
+    std::function<void(Shader&)> configure;
+    std::unordered_map<unsigned int, std::unique_ptr<Shader>> variants;
+};
+#endif
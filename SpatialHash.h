@@ -0,0 +1,91 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// uniform grid broadphase over a fixed box. Items are bucketed by the cell that contains their position,
+// so a sphere query only visits the cells its bounding box overlaps instead of every item. Positions
+// outside the box are clamped into the border cells, which keeps queries correct for them as well.
+// The grid is rebuilt from scratch with a counting sort: two passes over the items, no per-cell allocations.
+class SpatialHash
+{
+public:
+    SpatialHash(const glm::vec3& minBounds, const glm::vec3& maxBounds, float cellSize)
+        : origin(minBounds), cellSize(cellSize)
+    {
+        glm::vec3 extent = maxBounds - minBounds;
+        cellsX = std::max(1, (int)std::ceil(extent.x / cellSize));
+        cellsY = std::max(1, (int)std::ceil(extent.y / cellSize));
+        cellsZ = std::max(1, (int)std::ceil(extent.z / cellSize));
+        cellStart.resize((size_t)cellsX * cellsY * cellsZ + 1);
+    }
+
+    // buckets items[i] by positionOf(items[i]); the grid holds indices into items until the next build
+    template <typename T, typename PositionOf>
+    void build(const std::vector<T>& items, PositionOf positionOf)
+    {
+        std::fill(cellStart.begin(), cellStart.end(), 0);
+
+        itemCells.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            glm::vec3 position = positionOf(items[i]);
+            size_t cell = cellIndex(axisCell(position.x, origin.x, cellsX), axisCell(position.y, origin.y, cellsY), axisCell(position.z, origin.z, cellsZ));
+            itemCells[i] = cell;
+            cellStart[cell + 1]++;
+        }
+
+        for (size_t cell = 1; cell < cellStart.size(); cell++)
+            cellStart[cell] += cellStart[cell - 1];
+
+        cursor.assign(cellStart.begin(), cellStart.end() - 1);
+        entries.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+            entries[cursor[itemCells[i]]++] = i;
+    }
+
+    // calls visit(index) for every item in the cells overlapped by the sphere; the caller does the exact test
+    template <typename Visit>
+    void query(const glm::vec3& center, float radius, Visit visit) const
+    {
+        int minX = axisCell(center.x - radius, origin.x, cellsX), maxX = axisCell(center.x + radius, origin.x, cellsX);
+        int minY = axisCell(center.y - radius, origin.y, cellsY), maxY = axisCell(center.y + radius, origin.y, cellsY);
+        int minZ = axisCell(center.z - radius, origin.z, cellsZ), maxZ = axisCell(center.z + radius, origin.z, cellsZ);
+
+        for (int z = minZ; z <= maxZ; z++)
+            for (int y = minY; y <= maxY; y++)
+                for (int x = minX; x <= maxX; x++)
+                {
+                    size_t cell = cellIndex(x, y, z);
+                    for (size_t entry = cellStart[cell]; entry < cellStart[cell + 1]; entry++)
+                        visit(entries[entry]);
+                }
+    }
+
+private:
+    glm::vec3 origin;
+    float cellSize;
+    int cellsX, cellsY, cellsZ;
+
+    std::vector<size_t> cellStart; // entries of cell c are entries[cellStart[c] .. cellStart[c + 1])
+    std::vector<size_t> entries;   // item indices ordered by cell
+    std::vector<size_t> itemCells;
+    std::vector<size_t> cursor;
+
+    int axisCell(float value, float start, int cells) const
+    {
+        int cell = (int)std::floor((value - start) / cellSize);
+        return std::min(std::max(cell, 0), cells - 1);
+    }
+
+    size_t cellIndex(int x, int y, int z) const
+    {
+        return ((size_t)z * cellsY + y) * cellsX + x;
+    }
+};
+#endif
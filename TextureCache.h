@@ -0,0 +1,177 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <GL/glew.h>
+#include "stb_image.h"
+
+#include "GLState.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// how an image is decoded and sampled. It is part of the cache key, the same file loaded
+// with different options is a different texture.
+struct TextureOptions {
+    bool flipVertically = true;
+    bool mipmapFiltering = false; // GL_LINEAR_MIPMAP_LINEAR minification instead of GL_LINEAR
+};
+
+// process-wide texture registry shared by loadTexture (Main.cpp) and TextureFromFile (Model.h).
+// Textures are keyed by path and by a hash of the file contents, so an image is decoded and uploaded
+// only once even when it is reached through several paths. Every acquire() is matched by a release();
+// the GL texture is deleted together with its last reference.
+class TextureCache
+{
+public:
+    // statistics, reported by the benchmark
+    size_t decodes = 0;      // images decoded and uploaded
+    size_t pathHits = 0;     // requests answered by path without touching the file
+    size_t contentHits = 0;  // new paths whose contents matched an already loaded image
+
+    static TextureCache& instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // returns a texture for the image at path (0 if it can't be loaded) and takes a reference to it
+    unsigned int acquire(const std::string& path, const TextureOptions& options)
+    {
+        std::string pathKey = path + (options.flipVertically ? "|flip" : "|noflip") + (options.mipmapFiltering ? "|mip" : "|linear");
+
+        auto known = pathKeys.find(pathKey);
+        if (known != pathKeys.end())
+        {
+            pathHits++;
+            Entry& entry = entries[known->second];
+            entry.refCount++;
+            return entry.id;
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to load texture: " << path << std::endl;
+            return 0;
+        }
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        uint64_t key = hashContents(bytes) ^ ((options.flipVertically ? 1ull : 0ull) | (options.mipmapFiltering ? 2ull : 0ull));
+        pathKeys[pathKey] = key;
+
+        auto existing = entries.find(key);
+        if (existing != entries.end())
+        {
+            contentHits++;
+            existing->second.refCount++;
+            return existing->second.id;
+        }
+
+        unsigned int id = upload(bytes, path, options);
+        if (id == 0)
+        {
+            pathKeys.erase(pathKey);
+            return 0;
+        }
+
+        Entry entry;
+        entry.id = id;
+        entry.refCount = 1;
+        entries[key] = entry;
+        idKeys[id] = key;
+        decodes++;
+        return id;
+    }
+
+    // drops one reference; the texture is deleted when nobody uses it anymore
+    void release(unsigned int id)
+    {
+        auto idKey = idKeys.find(id);
+        if (idKey == idKeys.end())
+            return;
+
+        uint64_t key = idKey->second;
+        Entry& entry = entries[key];
+        if (--entry.refCount > 0)
+            return;
+
+        GLState::instance().forgetTexture(entry.id);
+        glDeleteTextures(1, &entry.id);
+        entries.erase(key);
+        idKeys.erase(idKey);
+        for (auto it = pathKeys.begin(); it != pathKeys.end();)
+        {
+            if (it->second == key)
+                it = pathKeys.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    size_t textureCount() const
+    {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        unsigned int id;
+        int refCount;
+    };
+
+    std::unordered_map<std::string, uint64_t> pathKeys;   // path + options -> content key
+    std::unordered_map<uint64_t, Entry> entries;          // content key -> texture
+    std::unordered_map<unsigned int, uint64_t> idKeys;    // texture id -> content key
+
+    TextureCache() {}
+
+    // 64-bit FNV-1a
+    static uint64_t hashContents(const std::vector<unsigned char>& bytes)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char byte : bytes)
+        {
+            hash ^= byte;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static unsigned int upload(const std::vector<unsigned char>& bytes, const std::string& path, const TextureOptions& options)
+    {
+        int width, height, nrComponents;
+        stbi_set_flip_vertically_on_load(options.flipVertically);
+        unsigned char* data = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &nrComponents, 0);
+        if (!data)
+        {
+            std::cerr << "Failed to load texture: " << path << std::endl;
+            return 0;
+        }
+
+        GLenum format = GL_RGB;
+        if (nrComponents == 1)
+            format = GL_RED;
+        else if (nrComponents == 4)
+            format = GL_RGBA;
+
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        GLState::instance().bindTexture(textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, options.mipmapFiltering ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(data);
+        return textureID;
+    }
+};
+#endif
@@ -0,0 +1,165 @@
+#ifndef TRANSPARENCY_PASS_H
+#define TRANSPARENCY_PASS_H
+
+#include <GL/glew.h>
+
+#include "GLState.h"
+#include "Shader.h"
+
+#include <iostream>
+
+// weighted blended order independent transparency (McGuire & Bavoil 2013).
+//
+// The opaque scene is rendered into an offscreen framebuffer. Transparent surfaces are then drawn in any order
+// into two targets that share its depth buffer (depth test on, depth writes off):
+//   accum  (RGBA16F): rgb = sum(color * alpha * weight), a = product(1 - alpha) (revealage)
+//   weight (R16F):    r   = sum(alpha * weight)
+// GL 3.3 has no per-target blend functions, so both use glBlendFuncSeparate(ONE, ONE, ZERO, ONE_MINUS_SRC_ALPHA):
+// colors add up, while the alpha channel of accum multiplies into the revealage.
+// The composite step blends the weighted average over the opaque scene, which is then blitted to the window.
+class TransparencyPass
+{
+public:
+    int width = 0;
+    int height = 0;
+
+    // allocates the targets for a window of the given size; needs a current GL context
+    void create(int width, int height)
+    {
+        this->width = width;
+        this->height = height;
+
+        GLState& state = GLState::instance();
+
+        // scene: color + depth, the opaque pass renders here
+        glGenRenderbuffers(1, &sceneColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, sceneColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &sceneFBO);
+        state.bindFramebuffer(sceneFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        checkComplete("scene");
+
+        // transparency targets, sharing the depth buffer of the scene
+        accumTexture = createTarget(GL_RGBA16F, GL_RGBA);
+        weightTexture = createTarget(GL_R16F, GL_RED);
+
+        glGenFramebuffers(1, &transparentFBO);
+        state.bindFramebuffer(transparentFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        checkComplete("transparency");
+
+        state.bindFramebuffer(0);
+
+        // core profile needs a bound VAO even for attribute-less draws
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    ~TransparencyPass()
+    {
+        GLState& state = GLState::instance();
+        state.forgetFramebuffer(sceneFBO);
+        state.forgetFramebuffer(transparentFBO);
+        state.forgetTexture(accumTexture);
+        state.forgetTexture(weightTexture);
+        state.forgetVertexArray(emptyVAO);
+
+        glDeleteFramebuffers(1, &sceneFBO);
+        glDeleteFramebuffers(1, &transparentFBO);
+        glDeleteRenderbuffers(1, &sceneColor);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteTextures(1, &accumTexture);
+        glDeleteTextures(1, &weightTexture);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    // start of the frame: the opaque pass renders into the scene framebuffer
+    void beginOpaque()
+    {
+        GLState& state = GLState::instance();
+        state.bindFramebuffer(sceneFBO);
+        state.depthMask(true);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // transparent surfaces: depth is tested against the opaque scene but never written
+    void beginTransparent()
+    {
+        GLState& state = GLState::instance();
+        state.bindFramebuffer(transparentFBO);
+
+        const GLfloat accumClear[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; // revealage starts at 1 (nothing covers the scene)
+        const GLfloat weightClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, accumClear);
+        glClearBufferfv(GL_COLOR, 1, weightClear);
+
+        state.setEnabled(GL_BLEND, true);
+        state.blendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+        state.depthMask(false);
+    }
+
+    // resolves the transparency targets over the scene and copies the result to the window
+    void composite(Shader& compositeShader)
+    {
+        GLState& state = GLState::instance();
+        state.bindFramebuffer(sceneFBO);
+
+        // the average color is blended with alpha = 1 - revealage
+        state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        state.setEnabled(GL_DEPTH_TEST, false);
+        state.depthMask(false);
+
+        // fullscreen triangle (oit_composite.vert), accum on unit 0 and weight on unit 1
+        compositeShader.use();
+        state.bindTexture(0, accumTexture);
+        state.bindTexture(1, weightTexture);
+        state.bindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        state.depthMask(true);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        // the tracked binding is still sceneFBO, so this really rebinds both read and draw to the window
+        state.bindFramebuffer(0);
+    }
+
+private:
+    unsigned int sceneFBO = 0, transparentFBO = 0;
+    unsigned int sceneColor = 0, depth = 0;
+    unsigned int accumTexture = 0, weightTexture = 0;
+    unsigned int emptyVAO = 0;
+
+    unsigned int createTarget(GLint internalFormat, GLenum format)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        GLState::instance().bindTexture(0, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    static void checkComplete(const char* name)
+    {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: " << name << " framebuffer is not complete" << std::endl;
+    }
+};
+#endif
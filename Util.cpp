@@ -3,6 +3,10 @@
 #include <GLFW/glfw3.h>
 
 #define _CRT_SECURE_NO_WARNINGS
+// stb_image implementacija se kompajlira samo ovde, ostali fajlovi ukljucuju samo deklaracije
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
 #include <fstream>
 #include <sstream>
 #include <iostream>
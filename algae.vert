@@ -0,0 +1,35 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+// --- Po instanci (jedna stabljika) ---
+layout(location = 3) in vec3 aBasePos;
+layout(location = 4) in vec3 aShape;      // x = visina, y = sirina, z = faza njisanja
+
+out vec3 chNormal;
+out vec3 chFragPos;
+
+#include "frame_data.glsl"
+
+uniform float uTime;
+
+void main()
+{
+    // Jedinicni valjak se skalira na visinu i sirinu stabljike
+    vec3 scale = vec3(aShape.y, aShape.x, aShape.y);
+
+    // Lagano njisanje stabljike po Z osi
+    float sway = sin(uTime + aShape.z) * 0.2;
+    float c = cos(sway);
+    float s = sin(sway);
+    mat3 rotation = mat3(c,   s,   0.0,
+                         -s,  c,   0.0,
+                         0.0, 0.0, 1.0);
+
+    chFragPos = aBasePos + rotation * (aPos * scale);
+    chNormal = rotation * normalize(aNormal / scale);
+
+    gl_Position = projection * view * vec4(chFragPos, 1.0);
+}
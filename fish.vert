@@ -8,14 +8,25 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
+#ifdef INSTANCED
+// Ribe iz jata (FishSchool): matrica modela stize po instanci i zauzima lokacije 3-6
+layout (location = 3) in mat4 inModel;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix;   // transpose(inverse(mat3(model))), racuna se jednom po objektu na CPU
+#endif
+
+#include "frame_data.glsl"
 
 void main()
 {
+#ifdef INSTANCED
+    // Instance imaju samo rotaciju i uniformnu skalu, pa mat3(model) ne krivi normale (fish.frag ih normalizuje)
+    mat4 model = inModel;
+    mat3 normalMatrix = mat3(inModel);
+#endif
     FragPos = vec3(model * vec4(inPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * inNormal;
+    Normal = normalMatrix * inNormal;
     TexCoords = inUV;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
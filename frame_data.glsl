@@ -0,0 +1,13 @@
+// Zajednicki uniform blok sa kamerom i svetlima (FrameData u FrameUniforms.h), salje se jednom po frejmu
+layout(std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 uViewPos;            // pozicija kamere
+    vec3 uLightPos;           // glavno svetlo
+    vec3 uLightColor;
+
+    // --- Klasterovana tackasta svetla ---
+    vec4 uClusterScale;       // xy: klasteri po pikselu, zw: skala i pomeraj dubinskih slojeva (log dubine)
+    ivec4 uClusterCount;      // broj klastera po x, y, z i broj svetala
+};
@@ -0,0 +1,27 @@
+#version 330 core
+
+in vec3 chNormal;
+in vec3 chFragPos;
+in float chAlpha;
+
+#include "lighting.glsl"
+#include "oit_output.glsl"
+
+uniform vec4 uColor;          // boja materijala, alfa se mnozi alfom instance
+
+void main()
+{
+    vec3 norm = normalize(chNormal);
+    vec3 viewDir = normalize(uViewPos - chFragPos);
+
+    // --- Glavno svetlo ---
+    vec3 diffuse, specular;
+    mainLight(norm, chFragPos, viewDir, diffuse, specular);
+
+    float ambientStrength = 0.2;
+    vec3 ambient = ambientStrength * uLightColor;
+
+    vec3 result = (ambient + diffuse + specular) * uColor.rgb;
+
+    writeColor(vec4(result, uColor.a * chAlpha));
+}
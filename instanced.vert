@@ -0,0 +1,25 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+// --- Po instanci ---
+layout(location = 3) in vec4 aInstance;       // xyz = pozicija, w = poluprecnik
+layout(location = 4) in float aInstanceAlpha;
+
+out vec3 chNormal;
+out vec3 chFragPos;
+out float chAlpha;
+
+#include "frame_data.glsl"
+
+void main()
+{
+    // Sfera se samo skalira i pomera, pa normala ostaje ista
+    chFragPos = aInstance.xyz + aPos * aInstance.w;
+    chNormal = aNormal;
+    chAlpha = aInstanceAlpha;
+
+    gl_Position = projection * view * vec4(chFragPos, 1.0);
+}
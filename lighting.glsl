@@ -0,0 +1,68 @@
+#include "frame_data.glsl"
+
+// --- Glavno svetlo ---
+// Difuzna i spekularna komponenta bez boje materijala; svaki sejder ih sam kombinuje sa svojom bojom
+void mainLight(vec3 norm, vec3 fragPos, vec3 viewDir, out vec3 diffuse, out vec3 specular)
+{
+    vec3 lightDir = normalize(uLightPos - fragPos);
+    diffuse = max(dot(norm, lightDir), 0.0) * uLightColor;
+
+    vec3 reflectDir = reflect(-lightDir, norm);
+    specular = 0.5 * pow(max(dot(viewDir, reflectDir), 0.0), 32.0) * uLightColor;
+}
+
+// --- Tackasto svetlo ---
+// Kvadratno slabljenje, koje se pred radijusom glatko spusta na nulu da bi svetlo imalo konacan domet.
+// radiance = boja * intenzitet; twoSided osvetljava i zadnju stranu povrsine (novcici, dragulj)
+vec3 pointLight(vec3 lightPos, float radius, vec3 radiance, vec3 norm, vec3 fragPos, vec3 viewDir, bool twoSided)
+{
+    vec3 lightDir = normalize(lightPos - fragPos);
+
+    float diffuseFactor = max(dot(norm, lightDir), 0.0);
+    if (twoSided)
+        diffuseFactor = max(diffuseFactor, max(dot(-norm, lightDir), 0.0));
+
+    float distance = length(lightPos - fragPos);
+    float falloff = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    float attenuation = falloff * falloff / (distance * distance);
+
+    vec3 diffuse = diffuseFactor * radiance * attenuation;
+
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+    vec3 specular = 0.3 * spec * radiance * attenuation;
+
+    return diffuse + specular;
+}
+
+#ifdef POINT_LIGHTS
+// --- Klasterovana svetla (ClusteredLights.h) ---
+// Ekran je podeljen na plocice, a dubina na eksponencijalne slojeve; CPU za svaki klaster upise listu svetala
+// koja ga dodiruju, pa fragment racuna samo svetla iz svog klastera
+uniform samplerBuffer uLightData;       // 2 texela po svetlu: (pozicija, radijus), (boja * intenzitet, 0)
+uniform usamplerBuffer uLightClusters;  // po klasteru: (pocetak u listi indeksa, broj svetala)
+uniform usamplerBuffer uLightIndices;   // indeksi svetala svih klastera
+
+int clusterIndex(vec3 fragPos)
+{
+    float depth = max(-(view * vec4(fragPos, 1.0)).z, 1e-4);
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * uClusterScale.xy), int(floor(log(depth) * uClusterScale.z + uClusterScale.w)));
+    cluster = clamp(cluster, ivec3(0), uClusterCount.xyz - 1);
+    return (cluster.z * uClusterCount.y + cluster.y) * uClusterCount.x + cluster.x;
+}
+
+vec3 pointLights(vec3 norm, vec3 fragPos, vec3 viewDir, bool twoSided)
+{
+    uvec2 cluster = texelFetch(uLightClusters, clusterIndex(fragPos)).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        int light = int(texelFetch(uLightIndices, int(cluster.x + i)).r);
+        vec4 positionRadius = texelFetch(uLightData, light * 2);
+        vec3 radiance = texelFetch(uLightData, light * 2 + 1).rgb;
+        result += pointLight(positionRadius.xyz, positionRadius.w, radiance, norm, fragPos, viewDir, twoSided);
+    }
+    return result;
+}
+#endif
@@ -0,0 +1,23 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D uAccum;     // rgb = suma boja * alfa * tezina, a = revealage
+uniform sampler2D uWeight;    // r = suma alfa * tezina
+
+void main()
+{
+    vec4 accum = texture(uAccum, TexCoords);
+    float revealage = accum.a;
+
+    // Nijedna providna povrsina ne pokriva ovaj piksel
+    if (revealage >= 1.0)
+        discard;
+
+    float weight = texture(uWeight, TexCoords).r;
+    vec3 average = accum.rgb / max(weight, 1e-5);
+
+    // Blend (SRC_ALPHA, ONE_MINUS_SRC_ALPHA) preko neprovidne scene
+    FragColor = vec4(average, 1.0 - revealage);
+}
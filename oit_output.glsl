@@ -0,0 +1,22 @@
+// --- Weighted blended OIT ---
+// U providnom prolazu boja ide u akumulacioni bafer (rgb = boja * alfa * tezina, a = alfa za revealage),
+// a suma tezina u drugi; redosled crtanja tada ne utice na rezultat
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 FragWeight;   // samo u providnom (OIT) prolazu
+
+uniform bool uOitPass;
+
+void writeColor(vec4 color)
+{
+    if (uOitPass)
+    {
+        float weight = clamp(color.a * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0)), 1e-2, 3e3);
+        FragColor = vec4(color.rgb * color.a * weight, color.a);
+        FragWeight = vec4(color.a * weight);
+    }
+    else
+    {
+        FragColor = color;
+        FragWeight = vec4(0.0);
+    }
+}
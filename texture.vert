@@ -8,13 +8,14 @@ out vec3 chNormal;
 out vec2 chUV;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix;   // transpose(inverse(mat3(model))), racuna se jednom po objektu na CPU
+
+#include "frame_data.glsl"
 
 void main()
 {
     chUV = inUV * 4.0; 
     chFragPos = vec3(model * vec4(inPos, 1.0));
-    chNormal = mat3(transpose(inverse(model))) * inNormal;
+    chNormal = normalMatrix * inNormal;
     gl_Position = projection * view * vec4(chFragPos, 1.0);
 }